@@ -2,55 +2,344 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <malloc.h>
+#include <alloca.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <x86intrin.h>
 
 #include "asmutil.h"
 
-/*!
- * \brief Variable type
+/*
+ * The allocation functions trace what they do to stderr unless this is built
+ * with -DASMUTIL_NOTRACE (i.e. for benchmarking).  Errors are always printed.
+ */
+#ifdef ASMUTIL_NOTRACE
+#define TRACE(...) ((void)0)
+#else
+#define TRACE(...) fprintf(stderr, __VA_ARGS__)
+#endif
+
+/*
+ * Variables, their value blocks and long YARNs come out of a pool instead of
+ * going to malloc each time.  Requests of up to POOL_MAX_BLOCK bytes
+ * (header included) are rounded up to a power of two and carved out of
+ * POOL_CHUNK byte chunks; freed blocks go on a free list for their size
+ * class and are handed out again before the chunk is touched.  Bigger
+ * requests go to malloc.  Each block starts with a pool_hdr_t so that it
+ * can be freed or grown without being told its size.
  */
-typedef union _val_t {
-  char *val_string;
-  long val_integer;
-  double val_float;
-  union _val_t *val_array;
-} value_t;
+#define POOL_CHUNK      65536
+#define POOL_MIN_SHIFT  4     /* the smallest block is 16 bytes */
+#define POOL_CLASSES    8     /* ... and the biggest is 2048 */
+#define POOL_MAX_BLOCK  (1 << (POOL_MIN_SHIFT + POOL_CLASSES - 1))
 
 typedef struct {
-  long var_type;
-  long dim_cnt;
-  long *dims;
-  value_t *vals;
-} variable_t;
+  long cls;  /* size class, or -1 for a block from malloc */
+  long size; /* usable bytes after the header */
+} pool_hdr_t;
+
+typedef struct pool_free_t {
+  struct pool_free_t *next;
+} pool_free_t;
+
+static pool_free_t *pool_lists[POOL_CLASSES];
+static char *pool_next = NULL, *pool_end = NULL;
+static lol_memstats_t pool_stats;
+
+static void *pool_alloc(long size)
+{
+  pool_hdr_t *hdr;
+  long cls = 0, total = size + sizeof(pool_hdr_t);
+
+  pool_stats.allocs += 1;
+  if (total > POOL_MAX_BLOCK)
+  {
+    hdr = (pool_hdr_t*)malloc(total);
+    if (hdr == NULL)
+    {
+      fprintf(stderr, "pool_alloc: Unable to allocate new memory! %ld bytes\n", total);
+      exit(1);
+    }
+    hdr->cls = -1;
+    hdr->size = size;
+    pool_stats.large += 1;
+  }
+  else
+  {
+    while ((1l << (POOL_MIN_SHIFT + cls)) < total)
+      ++cls;
+    total = 1l << (POOL_MIN_SHIFT + cls);
+    if (pool_lists[cls] != NULL)
+    {
+      hdr = (pool_hdr_t*)pool_lists[cls];
+      pool_lists[cls] = pool_lists[cls]->next;
+      pool_stats.reused += 1;
+    }
+    else
+    {
+      if (pool_end - pool_next < total)
+      {
+        pool_next = (char*)malloc(POOL_CHUNK);
+        if (pool_next == NULL)
+        {
+          fprintf(stderr, "pool_alloc: Unable to allocate a new chunk! %d bytes\n", POOL_CHUNK);
+          exit(1);
+        }
+        pool_end = pool_next + POOL_CHUNK;
+        pool_stats.chunks += 1;
+      }
+      hdr = (pool_hdr_t*)pool_next;
+      pool_next += total;
+    }
+    hdr->cls = cls;
+    hdr->size = total - sizeof(pool_hdr_t);
+  }
+  pool_stats.in_use += hdr->size;
+  if (pool_stats.in_use > pool_stats.peak)
+    pool_stats.peak = pool_stats.in_use;
+  return hdr + 1;
+}
+
+static void pool_free(void *block)
+{
+  pool_hdr_t *hdr = (pool_hdr_t*)block - 1;
+  long cls;
+  if (block == NULL)
+    return;
+  pool_stats.frees += 1;
+  pool_stats.in_use -= hdr->size;
+  if (hdr->cls < 0)
+  {
+    free(hdr);
+    return;
+  }
+  cls = hdr->cls; // the link overwrites the header
+  ((pool_free_t*)hdr)->next = pool_lists[cls];
+  pool_lists[cls] = (pool_free_t*)hdr;
+}
+
+/*!
+ * \brief How many bytes a block can hold (0 for NULL)
+ */
+static long pool_room(void *block)
+{
+  return (block != NULL) ? ((pool_hdr_t*)block - 1)->size : 0;
+}
+
+/*!
+ * \brief Grow (or allocate) a block, like realloc
+ */
+static void *pool_realloc(void *block, long size)
+{
+  void *bigger;
+  if (block == NULL)
+    return pool_alloc(size);
+  if (size <= ((pool_hdr_t*)block - 1)->size)
+    return block;
+  if (size + (long)sizeof(pool_hdr_t) > POOL_MAX_BLOCK)
+  { // leave room to grow, so an array filled one at a time isn't copied each time
+    long half = ((pool_hdr_t*)block - 1)->size / 2;
+    if (size < ((pool_hdr_t*)block - 1)->size + half)
+      size = ((pool_hdr_t*)block - 1)->size + half;
+  }
+  bigger = pool_alloc(size);
+  memcpy(bigger, block, ((pool_hdr_t*)block - 1)->size);
+  pool_free(block);
+  return bigger;
+}
+
+/*!
+ * \brief Get the pool's statistics
+ */
+void lol_memstats(lol_memstats_t *stats)
+{
+  *stats = pool_stats;
+}
+
+/*!
+ * \brief Print the pool's statistics to stderr
+ */
+void lol_memstats_print(void)
+{
+  fprintf(stderr, "lol memstats: %ld allocs (%ld reused, %ld large), %ld frees, "
+          "%ld bytes in use, %ld peak, %ld chunks\n",
+          pool_stats.allocs, pool_stats.reused, pool_stats.large, pool_stats.frees,
+          pool_stats.in_use, pool_stats.peak, pool_stats.chunks);
+}
+
+/*! The variables that have been allocated, newest first (see lol_scope_release) */
+static variable_t *scope_vars = NULL;
 
 /*!
  * \brief Allocate a new variable
  */
 void *varalloc(long var_type, long dim_cnt)
 {
-  variable_t *nvar = (void*)malloc(sizeof(variable_t));
+  variable_t *nvar = (variable_t*)pool_alloc(sizeof(variable_t));
   nvar->var_type = var_type;
   nvar->dim_cnt = dim_cnt;
   nvar->dims = NULL;
   nvar->vals = NULL;
+  nvar->sparse = NULL;
+  nvar->scope_next = scope_vars;
+  scope_vars = nvar;
 
-  fprintf(stderr, "varalloc: var@%p\n", nvar);
+  TRACE("varalloc: var@%p\n", nvar);
   return nvar;
 }
 
+/*!
+ * \brief Get the pointer kept in a YARN_HEAP or VAL_BUKKIT value
+ *
+ * The pointer is kept in the low bytes (all of them that fit before the tag),
+ * which works for both 32-bit and (user-space) 64-bit pointers.
+ */
+static void *val_pointer(const value_t *val)
+{
+  unsigned long p = 0;
+  memcpy(&p, val->val_bytes, sizeof(p) < 7 ? sizeof(p) : 7);
+  return (void*)p;
+}
+
+static void set_pointer(value_t *val, void *pointer, unsigned char tag)
+{
+  unsigned long p = (unsigned long)pointer;
+  memset(val, 0, sizeof(value_t));
+  memcpy(val->val_bytes, &p, sizeof(p) < 7 ? sizeof(p) : 7);
+  YARN_TAG(val) = tag;
+}
+
+/*
+ * A BUKKIT (the first dimension of a variable) starts out as a dense block of
+ * values.  When a store past its end means the block has to be copied into a
+ * bigger one anyway (and the new length is at least SPARSE_MIN), the values
+ * that are set are counted; if fewer than 1/SPARSE_GAP of the new length
+ * would be set, they are moved into a hash table instead, so that
+ * LOL MAH X!!1000000 R 1 doesn't need a million slots.  Once at least
+ * 1/DENSE_FILL of the length is set, the values go back into a dense block.
+ * Elements that were never set read as 0.
+ */
+#define SPARSE_MIN   1024
+#define SPARSE_GAP   8
+#define DENSE_FILL   2
+
+typedef struct {
+  long key;    /* the index, or -1 for an empty slot */
+  value_t val;
+} sparse_slot_t;
+
+typedef struct _sparse_t {
+  long used;   /* slots with a key */
+  long mask;   /* one less than the number of slots (a power of two) */
+  sparse_slot_t slots[1];
+} sparse_t;
+
+/*! What an element that isn't there reads as (never written to) */
+static value_t nothing;
+
+static void release_var(variable_t *var);
+
+/*!
+ * \brief Free whatever a value holds (a YARN or a nested BUKKIT)
+ */
+static void free_value(value_t *val)
+{
+  if (YARN_TAG(val) == VAL_BUKKIT)
+  {
+    release_var((variable_t*)val_pointer(val));
+    memset(val, 0, sizeof(value_t));
+  }
+  else
+  {
+    lol_yarn_free(val);
+  }
+}
+
+/*!
+ * \brief Free a (multi-dimensional) block of values and the YARNs in it
+ */
+static void free_values(value_t *val, long *sizes, long count)
+{
+  long d;
+  if (val == NULL)
+    return;
+  for (d = 0; d < *sizes; ++d)
+  {
+    if (count > 1)
+      free_values(val[d].val_array, sizes+1, count-1);
+    else
+      free_value(&val[d]);
+  }
+  pool_free(val);
+}
+
+/*!
+ * \brief Free a variable and everything in it
+ */
+static void release_var(variable_t *var)
+{
+  long s;
+  if (var->sparse != NULL)
+  {
+    for (s = 0; s <= var->sparse->mask; ++s)
+    {
+      if (var->sparse->slots[s].key >= 0)
+        free_value(&var->sparse->slots[s].val);
+    }
+    pool_free(var->sparse);
+  }
+  else if (var->dims != NULL)
+  {
+    free_values(var->vals, var->dims, var->dim_cnt);
+  }
+  pool_free(var->dims);
+  pool_free(var);
+}
+
+/*!
+ * \brief Free the variables declared in a block that is being left
+ *
+ * The compiler knows how many variables each block declares, and the block's
+ * variables are always the newest ones (the blocks inside it have already
+ * released theirs), so they are simply the first count on the list.
+ */
+void lol_scope_release(long count)
+{
+  TRACE("lol_scope_release: %ld variables\n", count);
+  while (count-- > 0 && scope_vars != NULL)
+  {
+    variable_t *var = scope_vars;
+    scope_vars = var->scope_next;
+    release_var(var);
+  }
+}
+
 void *validx(value_t *val, long index)
 {
-  fprintf(stderr, "validx: val@%p[%ld]\n", val, index);
-  fprintf(stderr, "validx: = %p (0x%lx)\n", (val+index), val[index].val_integer);
+  TRACE("validx: val@%p[%ld]\n", val, index);
+  TRACE("validx: = %p (0x%lx)\n", (val+index), val[index].val_integer);
   return (val+index);
 }
 
-void *dimalloc(value_t *val, long *sizes, long count)
+/*!
+ * \brief Resize a (multi-dimensional) block of values
+ *
+ * Slots that did not exist before are cleared, so the sub-arrays they hold
+ * start out empty.  A dimension of size 0 leaves its block alone.
+ *
+ * \param old_sizes The sizes the block had before (NULL if it is new)
+ */
+void *dimalloc(value_t *val, long *old_sizes, long *sizes, long count)
 {
-  long d;
+  long d, old;
   if (count <= 0)
   {
-    fprintf(stderr, "dimalloc: done!\n");
+    TRACE("dimalloc: done!\n");
     return val;
   }
   if (sizes == NULL)
@@ -58,22 +347,22 @@ void *dimalloc(value_t *val, long *sizes, long count)
     fprintf(stderr, "dimalloc: sizes == NULL!\n");
     exit(1);
   }
-  fprintf(stderr, "dimalloc: Allocating dimension (%ld left) for %ld values\n", count, *sizes);
-  val = (value_t*)realloc(val, (*sizes)*sizeof(value_t));
-  if (val == NULL)
-  {
-    fprintf(stderr, "dimalloc: Unable to allocate new memory! %ld bytes\n", (*sizes)*sizeof(value_t));
-    exit(1);
-  }
-  for (d = 0; d < *sizes; ++d)
+  if (*sizes == 0)
+    return val;
+  old = (old_sizes != NULL && val != NULL) ? *old_sizes : 0;
+  TRACE("dimalloc: Allocating dimension (%ld left) for %ld values\n", count, *sizes);
+  val = (value_t*)pool_realloc(val, (*sizes)*sizeof(value_t));
+  memset(val+old, 0, (*sizes-old)*sizeof(value_t)); // no sub-array, no YARN
+  for (d = 0; count > 1 && d < *sizes; ++d) // the last dimension holds no sub-arrays
   {
-    val[d].val_array = dimalloc(val[d].val_array, sizes+1, count-1);
+    val[d].val_array = dimalloc(val[d].val_array, (d < old) ? old_sizes+1 : NULL, sizes+1, count-1);
   }
   return val;
 }
 
 void vardimalloc(variable_t *var, long dim_num, long new_length)
 {
+  long *old_dims = NULL;
   if (var == NULL)
   {
     fprintf(stderr, "vardimalloc: NULL variable!\n");
@@ -87,15 +376,1197 @@ void vardimalloc(variable_t *var, long dim_num, long new_length)
   if (var->dims == NULL) // first allocation
   {
     // allocate the dimensions for the first time
-    fprintf(stderr, "vardimalloc: info: allocating variable\n");
-    var->dims = (long*)calloc(var->dim_cnt, sizeof(long));
-    if (var->dims == NULL)
+    TRACE("vardimalloc: info: allocating variable\n");
+    var->dims = (long*)pool_alloc(var->dim_cnt * sizeof(long));
+    memset(var->dims, 0, var->dim_cnt * sizeof(long));
+  }
+  else
+  {
+    // remember the old shape so dimalloc knows which slots are new
+    old_dims = (long*)alloca(var->dim_cnt * sizeof(long));
+    memcpy(old_dims, var->dims, var->dim_cnt * sizeof(long));
+  }
+  var->dims[dim_num] = new_length; 
+  var->vals = dimalloc(var->vals, old_dims, var->dims, var->dim_cnt);
+  TRACE("varalloc: var.vals@%p\n", var->vals);
+}
+
+/*!
+ * \brief Spread out indices for the hash table
+ */
+static unsigned long sparse_hash(long index)
+{
+  unsigned long h = (unsigned long)index * 2654435761ul;
+  return h ^ (h >> 16);
+}
+
+/*!
+ * \brief Make an empty hash table (slots must be a power of two)
+ */
+static sparse_t *sparse_new(long slots)
+{
+  long s;
+  sparse_t *table = (sparse_t*)pool_alloc(sizeof(sparse_t) + (slots-1)*sizeof(sparse_slot_t));
+  table->used = 0;
+  table->mask = slots - 1;
+  for (s = 0; s < slots; ++s)
+    table->slots[s].key = -1;
+  return table;
+}
+
+/*!
+ * \brief Find the slot holding an index, or the empty one it would go in
+ */
+static sparse_slot_t *sparse_find(sparse_t *table, long index)
+{
+  unsigned long s = sparse_hash(index) & table->mask;
+  while (table->slots[s].key != index && table->slots[s].key >= 0)
+    s = (s + 1) & table->mask;
+  return &table->slots[s];
+}
+
+/*!
+ * \brief Find (or add) an index in a sparse variable's hash table
+ *
+ * The table is kept at most half full, so it is doubled first if need be.
+ */
+static value_t *sparse_insert(variable_t *var, long index)
+{
+  sparse_t *table = var->sparse;
+  sparse_slot_t *slot;
+  long s;
+  if ((table->used + 1) * 2 > table->mask + 1)
+  {
+    sparse_t *bigger = sparse_new((table->mask + 1) * 2);
+    for (s = 0; s <= table->mask; ++s)
     {
-      fprintf(stderr, "vardimalloc: could not allocate memory: %ld bytes\n", var->dim_cnt * sizeof(long));
-      exit(1);
+      if (table->slots[s].key >= 0)
+        *sparse_find(bigger, table->slots[s].key) = table->slots[s];
     }
+    bigger->used = table->used;
+    pool_free(table);
+    var->sparse = table = bigger;
+  }
+  slot = sparse_find(table, index);
+  if (slot->key < 0)
+  {
+    slot->key = index;
+    memset(&slot->val, 0, sizeof(value_t));
+    table->used += 1;
+  }
+  return &slot->val;
+}
+
+/*!
+ * \brief Count the values in a dense block that are set (not all 0)
+ */
+static long count_set(const value_t *val, long len)
+{
+  long i, used = 0;
+  for (i = 0; i < len; ++i)
+  {
+    if (memcmp(&val[i], &nothing, sizeof(value_t)) != 0)
+      ++used;
+  }
+  return used;
+}
+
+/*!
+ * \brief Move the values of a dense BUKKIT that are set into a hash table
+ */
+static void make_sparse(variable_t *var, long used)
+{
+  long i, slots = 16;
+  while (slots < 2 * (used + 1))
+    slots *= 2;
+  var->sparse = sparse_new(slots);
+  for (i = 0; i < var->dims[0]; ++i)
+  {
+    if (memcmp(&var->vals[i], &nothing, sizeof(value_t)) != 0)
+      *sparse_insert(var, i) = var->vals[i];
+  }
+  pool_free(var->vals);
+  var->vals = NULL;
+  TRACE("make_sparse: var@%p: %ld of %ld set\n", var, used, var->dims[0]);
+}
+
+/*!
+ * \brief Move the values of a sparse BUKKIT back into a dense block
+ */
+static void make_dense(variable_t *var)
+{
+  sparse_t *table = var->sparse;
+  long s;
+  TRACE("make_dense: var@%p: %ld of %ld set\n", var, table->used, var->dims[0]);
+  var->vals = (value_t*)pool_alloc(var->dims[0] * sizeof(value_t));
+  memset(var->vals, 0, var->dims[0] * sizeof(value_t));
+  for (s = 0; s <= table->mask; ++s)
+  {
+    if (table->slots[s].key >= 0)
+      var->vals[table->slots[s].key] = table->slots[s].val;
+  }
+  pool_free(table);
+  var->sparse = NULL;
+}
+
+/*!
+ * \brief Find an element that isn't simply in the dense block
+ *
+ * Reading an element that isn't there gives nothing; storing to one makes
+ * room for it, growing the dense block or switching representations.
+ */
+static value_t *bukkit_slot(variable_t *var, long index, long mode)
+{
+  long len = (var->dims != NULL) ? var->dims[0] : 0;
+  if (index < 0)
+  {
+    if (!(mode & LOL_AT_STORE))
+      return &nothing;
+    lol_flush(); // (whatever was VISIBLE before this)
+    fprintf(stderr, "lol_bukkit_at: index %ld out of range!\n", index);
+    lol_exit(1);
+  }
+  if (var->sparse != NULL)
+  {
+    sparse_slot_t *slot;
+    value_t *val;
+    if (!(mode & LOL_AT_STORE))
+    {
+      slot = sparse_find(var->sparse, index);
+      return (slot->key >= 0) ? &slot->val : &nothing;
+    }
+    val = sparse_insert(var, index);
+    if (index >= len)
+      var->dims[0] = len = index + 1;
+    if (var->sparse->used * DENSE_FILL < len)
+      return val;
+    make_dense(var);
+    return var->vals + index;
+  }
+  if (index < len)
+    return var->vals + index;
+  if (!(mode & LOL_AT_STORE))
+    return &nothing;
+  if (var->dims == NULL)
+    vardimalloc(var, 0, 0);
+  if (index >= SPARSE_MIN && (index + 1) * (long)sizeof(value_t) > pool_room(var->vals))
+  { // the block is about to be copied: see whether it is worth it
+    long used = count_set(var->vals, len);
+    if ((used + 1) * SPARSE_GAP <= index)
+    {
+      make_sparse(var, used);
+      return bukkit_slot(var, index, mode);
+    }
+  }
+  vardimalloc(var, 0, index + 1);
+  return var->vals + index;
+}
+
+/*!
+ * \brief Find an element of a variable (MAH var!!index)
+ *
+ * This is what the generated code uses for every element, whether the
+ * variable is dense or sparse.  An element holding a nested BUKKIT stands for
+ * its own first element, unless it is about to be indexed (LOL_AT_BUKKIT).
+ *
+ * \param mode LOL_AT_STORE and/or LOL_AT_BUKKIT
+ * \return The element (or a 0 that must not be changed, if it isn't there and
+ * this isn't a store)
+ */
+value_t *lol_bukkit_at(variable_t *var, long index, long mode)
+{
+  value_t *val;
+  if (mode == (LOL_AT_STORE | LOL_AT_BUKKIT))
+    var->var_type = TYPE_BUKKIT; // (see lol_bukkit_span)
+  if (var->vals != NULL && (unsigned long)index < (unsigned long)var->dims[0])
+    val = var->vals + index;
+  else
+    val = bukkit_slot(var, index, mode);
+  if (YARN_TAG(val) == VAL_BUKKIT && !(mode & LOL_AT_BUKKIT))
+    return lol_bukkit_at((variable_t*)val_pointer(val), 0, mode);
+  return val;
+}
+
+/*!
+ * \brief Find an element of an element (MAH MAH var!!i!!index)
+ *
+ * Storing into an element that doesn't hold a BUKKIT yet turns it into one,
+ * with what it held as the first element.
+ *
+ * \param val What lol_bukkit_at (or this) gave with LOL_AT_BUKKIT
+ */
+value_t *lol_bukkit_sub(value_t *val, long index, long mode)
+{
+  if (YARN_TAG(val) != VAL_BUKKIT)
+  {
+    variable_t *var;
+    if (!(mode & LOL_AT_STORE))
+      return (index == 0) ? val : &nothing;
+    var = (variable_t*)pool_alloc(sizeof(variable_t));
+    var->var_type = TYPE_IDK;
+    var->dim_cnt = 1;
+    var->dims = NULL;
+    var->vals = NULL;
+    var->sparse = NULL;
+    var->scope_next = NULL;
+    vardimalloc(var, 0, 1);
+    var->vals[0] = *val;
+    set_pointer(val, var, VAL_BUKKIT);
+  }
+  return lol_bukkit_at((variable_t*)val_pointer(val), index, mode);
+}
+
+/*!
+ * \brief Find a run of elements that are next to each other
+ *
+ * This is for the vectorized loops, which work on the elements directly.
+ * With LOL_AT_STORE, room is made for all of them first (as storing to each
+ * of them in turn would).
+ *
+ * \return The first element, or NULL if the elements aren't all there in a
+ * dense block of plain values (the loop has to take them one at a time then)
+ */
+value_t *lol_bukkit_span(variable_t *var, long start, long count, long mode)
+{
+  if (start < 0 || count <= 0 || var->var_type == TYPE_BUKKIT)
+    return NULL;
+  if (mode & LOL_AT_STORE)
+    lol_bukkit_at(var, start + count - 1, LOL_AT_STORE);
+  if (var->vals == NULL || count > var->dims[0] - start)
+    return NULL;
+  return var->vals + start;
+}
+
+/*!
+ * \brief Find the block of a YARN_HEAP yarn
+ */
+static yarn_block_t *yarn_block(const value_t *yarn)
+{
+  return (yarn_block_t*)val_pointer(yarn);
+}
+
+static void set_block(value_t *yarn, yarn_block_t *block)
+{
+  set_pointer(yarn, block, YARN_HEAP);
+}
+
+/*
+ * The files GIMMEH ... OUTTA has mapped, which YARN_SLICE yarns point into (by
+ * the index in their byte 6).  They stay mapped until the program ends.
+ */
+#define LOL_FILES_MAX 16
+static const char *mapped_files[LOL_FILES_MAX];
+
+/*!
+ * \brief Find the text of a YARN_SLICE yarn
+ */
+static const char *slice_text(const value_t *yarn)
+{
+  unsigned offset;
+  memcpy(&offset, yarn->val_bytes, 4);
+  return mapped_files[yarn->val_bytes[6]] + offset;
+}
+
+static long slice_len(const value_t *yarn)
+{
+  return yarn->val_bytes[4] | (yarn->val_bytes[5] << 8);
+}
+
+/*!
+ * \brief Allocate a block with room for at least cap bytes of text
+ */
+static yarn_block_t *new_block(long cap)
+{
+  yarn_block_t *block = (yarn_block_t*)pool_alloc(sizeof(yarn_block_t) + cap);
+  block->len = 0;
+  block->cap = cap;
+  block->text[0] = '\0';
+  return block;
+}
+
+/*!
+ * \brief Get the length of a YARN (0 for anything that is not one)
+ */
+long lol_yarn_len(const value_t *yarn)
+{
+  unsigned char tag = YARN_TAG(yarn);
+  if (tag & YARN_INLINE)
+    return tag & ~YARN_INLINE;
+  if (tag == YARN_HEAP)
+    return yarn_block(yarn)->len;
+  if (tag == YARN_SLICE)
+    return slice_len(yarn);
+  return 0;
+}
+
+/*!
+ * \brief Get the text of a YARN
+ *
+ * The text is lol_yarn_len bytes long; it is only '\0'-terminated when it is
+ * kept in a block (a YARN_SLICE is followed by the rest of its file).
+ */
+const char *lol_yarn_text(const value_t *yarn)
+{
+  if (YARN_TAG(yarn) == YARN_HEAP)
+    return yarn_block(yarn)->text;
+  if (YARN_TAG(yarn) == YARN_SLICE)
+    return slice_text(yarn);
+  return (const char*)yarn->val_bytes;
+}
+
+/*!
+ * \brief Release the text of a YARN, leaving no YARN at all
+ *
+ * It is safe to call this on any value: only a YARN_HEAP yarn that is not a
+ * constant has anything to free.
+ */
+void lol_yarn_free(value_t *yarn)
+{
+  if (YARN_TAG(yarn) == YARN_HEAP && yarn_block(yarn)->cap != 0)
+    pool_free(yarn_block(yarn));
+  memset(yarn, 0, sizeof(value_t));
+}
+
+/*!
+ * \brief Store a copy of some text in a YARN
+ */
+void lol_yarn_set(value_t *yarn, const char *text, long len)
+{
+  lol_yarn_free(yarn);
+  if (len <= YARN_INLINE_MAX)
+  {
+    memcpy(yarn->val_bytes, text, len);
+    YARN_TAG(yarn) = YARN_INLINE | len;
+  }
+  else
+  {
+    yarn_block_t *block = new_block(len);
+    memcpy(block->text, text, len);
+    block->text[len] = '\0';
+    block->len = len;
+    set_block(yarn, block);
+  }
+}
+
+/*!
+ * \brief Write the decimal text of a NUMBR so that it ends at end
+ *
+ * The digits are made two at a time from a table (no division by 10 per
+ * digit and no printf).  There must be room for 24 bytes before end.
+ *
+ * \return Where the text starts
+ */
+static char *numbr_digits(long number, char *end)
+{
+  static const char pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  char *p = end;
+  unsigned long n = (number < 0) ? 0ul - (unsigned long)number : (unsigned long)number;
+  while (n >= 100)
+  {
+    unsigned long pair = n % 100;
+    n /= 100;
+    p -= 2;
+    memcpy(p, pairs + pair*2, 2);
+  }
+  if (n >= 10)
+  {
+    p -= 2;
+    memcpy(p, pairs + n*2, 2);
+  }
+  else
+  {
+    *--p = '0' + n;
+  }
+  if (number < 0)
+    *--p = '-';
+  return p;
+}
+
+/*!
+ * \brief Store the decimal text of a NUMBR in a YARN
+ */
+void lol_yarn_numbr(value_t *yarn, long number)
+{
+  char buf[24], *p = numbr_digits(number, buf + sizeof(buf));
+  lol_yarn_set(yarn, p, buf + sizeof(buf) - p);
+}
+
+/*!
+ * \brief Check whether a value holds a YARN (and not a NUMBR or a BUKKIT)
+ */
+static int is_yarn(const value_t *val)
+{
+  return (YARN_TAG(val) & (YARN_INLINE | YARN_SLICE | YARN_HEAP)) != 0;
+}
+
+/*!
+ * \brief Get the text of a value: a YARN's own, or the digits of a NUMBR
+ *
+ * \param digits Room for the digits (24 bytes)
+ * \param len Set to the length of the text
+ */
+static const char *value_text(const value_t *val, char *digits, long *len)
+{
+  char *p;
+  if (is_yarn(val))
+  {
+    *len = lol_yarn_len(val);
+    return lol_yarn_text(val);
+  }
+  p = numbr_digits(val->val_integer, digits + 24);
+  *len = digits + 24 - p;
+  return p;
+}
+
+/*!
+ * \brief Assign a copy of a YARN (constants are shared, not copied)
+ */
+void lol_yarn_copy(value_t *dst, const value_t *src)
+{
+  if (dst == src)
+    return;
+  if (YARN_TAG(src) == YARN_HEAP && yarn_block(src)->cap != 0)
+  {
+    lol_yarn_set(dst, yarn_block(src)->text, yarn_block(src)->len);
+    return;
+  }
+  lol_yarn_free(dst);
+  *dst = *src;
+}
+
+/*!
+ * \brief Assign a YARN without copying its text (src is left empty)
+ */
+void lol_yarn_move(value_t *dst, value_t *src)
+{
+  if (dst == src)
+    return;
+  lol_yarn_free(dst);
+  *dst = *src;
+  memset(src, 0, sizeof(value_t));
+}
+
+/*!
+ * \brief Add text to the end of a YARN
+ *
+ * A YARN that is appended to over and over (i.e. UPZ LINE!!"...") gets a block
+ * that doubles as it grows, so this takes amortized constant time per byte.
+ *
+ * \param self Set when the text is the YARN's own
+ */
+static void append_text(value_t *dst, const char *text, long add, int self)
+{
+  long len = lol_yarn_len(dst);
+  char inline_text[YARN_INLINE_MAX];
+  yarn_block_t *block;
+
+  if (add == 0)
+    return;
+  if (YARN_TAG(dst) == YARN_SLICE)
+    lol_yarn_set(dst, lol_yarn_text(dst), len); // a file is never written to
+  if (YARN_TAG(dst) != YARN_HEAP && !(YARN_TAG(dst) & YARN_INLINE))
+    memset(dst, 0, sizeof(value_t)); // not a YARN yet
+  if (YARN_TAG(dst) != YARN_HEAP && len + add <= YARN_INLINE_MAX)
+  {
+    memmove(dst->val_bytes + len, text, add);
+    YARN_TAG(dst) = YARN_INLINE | (len + add);
+    return;
+  }
+  if (self && YARN_TAG(dst) & YARN_INLINE)
+  { // about to be overwritten by the block pointer
+    memcpy(inline_text, text, add);
+    text = inline_text;
+  }
+
+  block = (YARN_TAG(dst) == YARN_HEAP) ? yarn_block(dst) : NULL;
+  if (block == NULL || block->cap < len + add)
+  {
+    long cap = (block != NULL && block->cap * 2 > len + add) ? block->cap * 2 : len + add;
+    if (cap < 32)
+      cap = 32;
+    if (block != NULL && block->cap != 0)
+    {
+      block = (yarn_block_t*)pool_realloc(block, sizeof(yarn_block_t) + cap);
+      block->cap = cap;
+      if (self)
+        text = block->text; // it moved
+    }
+    else
+    {
+      block = new_block(cap);
+      memcpy(block->text, lol_yarn_text(dst), len);
+    }
+    set_block(dst, block);
+  }
+  memcpy(block->text + len, text, add);
+  block->len = len + add;
+  block->text[block->len] = '\0';
+}
+
+/*!
+ * \brief Add a YARN to the end of another one (which may be the same YARN)
+ *
+ * Either one may be a NUMBR, which is turned into its digits first.
+ */
+void lol_yarn_append(value_t *dst, const value_t *src)
+{
+  char digits[24];
+  const char *text;
+  long len;
+  if (YARN_TAG(dst) == 0)
+    lol_yarn_numbr(dst, dst->val_integer);
+  text = value_text(src, digits, &len);
+  append_text(dst, text, len, src == dst);
+}
+
+/*!
+ * \brief Put two YARNs together into a third
+ *
+ * Either one may be a NUMBR, which is turned into its digits first.
+ */
+void lol_yarn_concat(value_t *dst, const value_t *a, const value_t *b)
+{
+  char adigits[24], bdigits[24];
+  long alen, blen;
+  const char *atext = value_text(a, adigits, &alen), *btext = value_text(b, bdigits, &blen);
+  if (dst == b && dst != a)
+  { // would be overwritten before it is used
+    value_t tmp = {0};
+    lol_yarn_concat(&tmp, a, b);
+    lol_yarn_move(dst, &tmp);
+    return;
+  }
+  if (dst != a)
+  {
+    if (alen + blen <= YARN_INLINE_MAX)
+    {
+      value_t tmp = {0};
+      memcpy(tmp.val_bytes, atext, alen);
+      memcpy(tmp.val_bytes + alen, btext, blen);
+      YARN_TAG(&tmp) = YARN_INLINE | (alen + blen);
+      lol_yarn_free(dst);
+      *dst = tmp;
+      return;
+    }
+    else
+    {
+      yarn_block_t *block = new_block(alen + blen);
+      memcpy(block->text, atext, alen);
+      block->len = alen;
+      lol_yarn_free(dst);
+      set_block(dst, block);
+    }
+  }
+  lol_yarn_append(dst, b);
+}
+
+/*!
+ * \brief Compare two YARNs (like memcmp, then shorter first)
+ *
+ * A NUMBR is compared by its digits.
+ *
+ * \return Less than, equal to or greater than 0 as a is before, the same as
+ * or after b
+ */
+long lol_yarn_cmp(const value_t *a, const value_t *b)
+{
+  char adigits[24], bdigits[24];
+  const char *atext, *btext;
+  long alen, blen;
+  int diff;
+  if (YARN_TAG(a) & YARN_INLINE && YARN_TAG(a) == YARN_TAG(b) &&
+      memcmp(a->val_bytes, b->val_bytes, sizeof(value_t)) == 0)
+    return 0; // same short text (the unused bytes are always 0)
+  atext = value_text(a, adigits, &alen);
+  btext = value_text(b, bdigits, &blen);
+  diff = memcmp(atext, btext, alen < blen ? alen : blen);
+  if (diff != 0)
+    return diff;
+  return alen - blen;
+}
+
+/*
+ * A variable that a YARN can be stored in anywhere may hold either a YARN or
+ * a NUMBR when the program runs, so the code the compiler makes for it asks
+ * these which one it is.
+ */
+
+/*!
+ * \brief Get the NUMBR a value holds (a YARN can't be used as one)
+ */
+long lol_value_numbr(const value_t *val)
+{
+  char digits[24];
+  const char *text;
+  long len;
+  if (!is_yarn(val))
+    return val->val_integer;
+  text = value_text(val, digits, &len);
+  lol_flush(); // (whatever was VISIBLE before this)
+  fprintf(stderr, "lol_value_numbr: the YARN \"%.*s\" is not a NUMBR!\n", (int)len, text);
+  lol_exit(1);
+  return 0;
+}
+
+/*!
+ * \brief UP a AN b: add two NUMBRs, or put the two together if either is a YARN
+ */
+void lol_value_add(value_t *dst, const value_t *a, const value_t *b)
+{
+  long sum;
+  if (is_yarn(a) || is_yarn(b))
+  {
+    lol_yarn_concat(dst, a, b);
+    return;
+  }
+  sum = a->val_integer + b->val_integer;
+  lol_yarn_free(dst);
+  dst->val_integer = sum;
+}
+
+/*!
+ * \brief UPZ dst!!src: lol_value_add in place
+ */
+void lol_value_append(value_t *dst, const value_t *src)
+{
+  if (is_yarn(dst) || is_yarn(src))
+    lol_yarn_append(dst, src);
+  else
+    dst->val_integer += src->val_integer;
+}
+
+/*!
+ * \brief Compare two NUMBRs, or (if either is a YARN) their text
+ *
+ * \return Less than, equal to or greater than 0 as a is before, the same as
+ * or after b
+ */
+long lol_value_cmp(const value_t *a, const value_t *b)
+{
+  if (is_yarn(a) || is_yarn(b))
+    return lol_yarn_cmp(a, b);
+  return (a->val_integer > b->val_integer) - (a->val_integer < b->val_integer);
+}
+
+/*
+ * VISIBLE and GIMMEH go through big buffers of our own so that a program
+ * that prints (or reads) a line at a time only makes a system call every
+ * LOL_IO_BUFSIZE bytes.  The output is flushed when the program exits (see
+ * lol_exit) and before it waits for input.  GIMMEH at the end of the input
+ * ends the program, so a filter is just a loop around GIMMEH.
+ *
+ * GIMMEH ... OUTTA a file that can be mapped does not read it at all: the
+ * whole file is the buffer, and a line or word read from it is a YARN_SLICE
+ * of it instead of a copy.  Anything else (a pipe, a terminal, ...) gets a
+ * buffer like stdin's.
+ */
+#define LOL_IO_BUFSIZE 65536
+
+static char out_buf[LOL_IO_BUFSIZE];
+static long out_len = 0;
+
+/*!
+ * \brief Somewhere GIMMEH reads from
+ */
+typedef struct {
+  char *name;  /*!< The name it was opened by (NULL for stdin) */
+  long name_len;
+  int fd;
+  int mapped;  /*!< Set when buf is the whole file (and is never read into) */
+  char *buf;   /*!< The input waiting is from pos to end */
+  long pos;
+  long end;
+} lol_input_t;
+
+static char in_buf[LOL_IO_BUFSIZE];
+static lol_input_t inputs[LOL_FILES_MAX] = { { NULL, 0, 0, 0, in_buf, 0, 0 } };
+static long input_count = 1;
+
+static unsigned long long last_name = 0; /* the value_t open_input found last */
+static lol_input_t *last_input = NULL;
+
+/*!
+ * \brief Write all of a buffer to a file descriptor
+ */
+static void write_all(int fd, const char *data, long len)
+{
+  while (len > 0)
+  {
+    long n = write(fd, data, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+    {
+      out_len = 0; // nothing more is going anywhere
+      exit(1);
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+/*!
+ * \brief Write out everything VISIBLE has buffered
+ */
+void lol_flush(void)
+{
+  if (out_len > 0)
+    write_all(1, out_buf, out_len);
+  out_len = 0;
+}
+
+static void print_text(const char *text, long len)
+{
+  if (out_len + len > LOL_IO_BUFSIZE)
+  {
+    lol_flush();
+    if (len >= LOL_IO_BUFSIZE)
+    { // no point copying it
+      write_all(1, text, len);
+      return;
+    }
+  }
+  memcpy(out_buf + out_len, text, len);
+  out_len += len;
+}
+
+/*!
+ * \brief VISIBLE a NUMBR (see numbr_digits)
+ */
+void lol_print_numbr(long number)
+{
+  char buf[24], *p = numbr_digits(number, buf + sizeof(buf));
+  print_text(p, buf + sizeof(buf) - p);
+}
+
+/*!
+ * \brief VISIBLE a YARN (or the digits of a NUMBR)
+ */
+void lol_print_yarn(const value_t *yarn)
+{
+  char digits[24];
+  long len;
+  const char *text = value_text(yarn, digits, &len);
+  print_text(text, len);
+}
+
+/*!
+ * \brief End a line of VISIBLE output (unless it ended with a !)
+ */
+void lol_print_newline(void)
+{
+  if (out_len == LOL_IO_BUFSIZE)
+    lol_flush();
+  out_buf[out_len++] = '\n';
+}
+
+/*!
+ * \brief Print a line to stderr (for DIAF), after whatever was VISIBLE before it
+ */
+void lol_print_error(const value_t *yarn)
+{
+  char digits[24];
+  long len;
+  const char *text = value_text(yarn, digits, &len);
+  lol_flush();
+  write_all(2, text, len);
+  write_all(2, "\n", 1);
+}
+
+/*!
+ * \brief End the program (KTHXBYE, BYES or DIAF)
+ *
+ * The pool's statistics are printed first when LOL_MEMSTATS is set in the
+ * environment, and so is the lcc -profile report (however the program ends).
+ */
+void lol_exit(long status)
+{
+  lol_flush();
+  lolprof_dump();
+  if (getenv("LOL_MEMSTATS") != NULL)
+    lol_memstats_print();
+  exit(status);
+}
+
+/*!
+ * \brief Make sure there is input waiting
+ *
+ * \return The number of bytes waiting (0 at the end of the input)
+ */
+static long fill_input(lol_input_t *in)
+{
+  long n;
+  if (in->pos < in->end)
+    return in->end - in->pos;
+  if (in->mapped)
+    return 0;
+  if (in->fd == 0)
+    lol_flush(); // show any prompt first
+  in->pos = in->end = 0;
+  do
+  {
+    n = read(in->fd, in->buf, LOL_IO_BUFSIZE);
+  } while (n < 0 && errno == EINTR);
+  if (n > 0)
+    in->end = n;
+  return in->end;
+}
+
+/*!
+ * \brief Find the file GIMMEH ... OUTTA reads from, opening it the first time
+ *
+ * A loop reading from the same (short or constant) name again doesn't have
+ * to look at its text.
+ */
+static lol_input_t *open_input(const value_t *name)
+{
+  char digits[24];
+  long len, i;
+  const char *text = value_text(name, digits, &len);
+  unsigned long long key;
+  lol_input_t *in;
+  struct stat st;
+
+  memcpy(&key, name->val_bytes, sizeof(key));
+  if (last_input != NULL && key == last_name &&
+      (YARN_TAG(name) != YARN_HEAP || yarn_block(name)->cap == 0))
+    return last_input;
+  last_name = key;
+  for (i = 1; i < input_count; ++i)
+  {
+    if (inputs[i].name_len == len && memcmp(inputs[i].name, text, len) == 0)
+      return last_input = &inputs[i];
+  }
+  if (input_count == LOL_FILES_MAX)
+  {
+    lol_flush();
+    fprintf(stderr, "lol_gimmeh: Unable to open more than %d files!\n", LOL_FILES_MAX - 1);
+    lol_exit(1);
+  }
+
+  in = &inputs[input_count];
+  in->name = (char*)malloc(len + 1);
+  memcpy(in->name, text, len);
+  in->name[len] = '\0';
+  in->name_len = len;
+  do
+  {
+    in->fd = open(in->name, O_RDONLY);
+  } while (in->fd < 0 && errno == EINTR);
+  if (in->fd < 0)
+  {
+    lol_flush();
+    fprintf(stderr, "lol_gimmeh: Unable to open %s: %s\n", in->name, strerror(errno));
+    lol_exit(1);
+  }
+
+  in->pos = in->end = 0;
+  in->mapped = 0;
+  if (fstat(in->fd, &st) == 0 && S_ISREG(st.st_mode))
+  {
+    void *map = (st.st_size > 0) ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0) : NULL;
+    if (map != MAP_FAILED)
+    { // (an empty file has nothing to map, and nothing to read either)
+      if (map != NULL)
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+      in->buf = (char*)map;
+      in->end = st.st_size;
+      in->mapped = 1;
+      mapped_files[input_count] = in->buf;
+      close(in->fd);
+      in->fd = -1;
+    }
+  }
+  if (!in->mapped)
+    in->buf = (char*)malloc(LOL_IO_BUFSIZE);
+  return last_input = &inputs[input_count++];
+}
+
+static int is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/*
+ * The ends of lines and words are found 16 bytes at a time, with SSE2 even
+ * though the runtime is built with plain -m32.  gcc may keep the vectors in
+ * 16-byte aligned stack slots, and lcc doesn't keep %esp aligned at its
+ * calls, so the lol_gimmeh_* entry points realign the stack (LOL_REALIGN).
+ */
+#define LOL_REALIGN __attribute__((force_align_arg_pointer))
+
+/*!
+ * \brief Find the first newline in some text
+ *
+ * \return Where it is, or NULL if there is none
+ */
+__attribute__((target("sse2")))
+static const char *find_newline(const char *p, long len)
+{
+  const char *end = p + len;
+  __m128i newline = _mm_set1_epi8('\n');
+  for (; end - p >= 16; p += 16)
+  {
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), newline));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+  for (; p < end; ++p)
+  {
+    if (*p == '\n')
+      return p;
+  }
+  return NULL;
+}
+
+/*!
+ * \brief Find the first blank (or the first byte that is not one) in some text
+ *
+ * \param blank 1 to find a blank, 0 to skip them
+ * \return Where it is, or the end of the text if there is none
+ */
+__attribute__((target("sse2")))
+static const char *find_blank(const char *p, long len, int blank)
+{
+  const char *end = p + len;
+  __m128i space = _mm_set1_epi8(' ');
+  __m128i lo = _mm_set1_epi8('\t' - 1), hi = _mm_set1_epi8('\r' + 1);
+  unsigned flip = blank ? 0 : 0xFFFF;
+  for (; end - p >= 16; p += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i blanks = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                  _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmpgt_epi8(hi, v)));
+    unsigned mask = _mm_movemask_epi8(blanks) ^ flip;
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+  while (p < end && is_blank(*p) != blank)
+    ++p;
+  return p;
+}
+
+/*!
+ * \brief Empty a YARN that is about to be read into, keeping its block
+ */
+static void yarn_clear(value_t *yarn)
+{
+  if (YARN_TAG(yarn) == YARN_HEAP && yarn_block(yarn)->cap != 0)
+  {
+    yarn_block(yarn)->len = 0;
+    yarn_block(yarn)->text[0] = '\0';
+    return;
+  }
+  lol_yarn_free(yarn);
+  YARN_TAG(yarn) = YARN_INLINE; // empty, but a YARN
+}
+
+/*!
+ * \brief Add some of the input (which has been read past) to a YARN
+ *
+ * Text in a mapped file is not copied if a YARN_SLICE can hold it: it is up
+ * to 64KB long, and starts in the first 4GB of the file.
+ */
+static void take_text(lol_input_t *in, value_t *yarn, const char *start, long len)
+{
+  unsigned long offset = start - in->buf;
+  if (in->mapped && len > YARN_INLINE_MAX && len <= 0xFFFF &&
+      offset <= 0xFFFFFFFFul && lol_yarn_len(yarn) == 0)
+  {
+    unsigned offset32 = offset;
+    lol_yarn_free(yarn);
+    memcpy(yarn->val_bytes, &offset32, 4);
+    yarn->val_bytes[4] = len & 0xFF;
+    yarn->val_bytes[5] = len >> 8;
+    yarn->val_bytes[6] = in - inputs;
+    YARN_TAG(yarn) = YARN_SLICE;
+    return;
+  }
+  append_text(yarn, start, len, 0);
+}
+
+/*!
+ * \brief GIMMEH LINE: read up to the next newline (which is dropped)
+ *
+ */
+static void read_line(lol_input_t *in, value_t *yarn)
+{
+  long avail;
+  yarn_clear(yarn);
+  if (fill_input(in) == 0)
+    lol_exit(0);
+  while ((avail = fill_input(in)) > 0)
+  {
+    const char *start = in->buf + in->pos;
+    const char *newline = find_newline(start, avail);
+    if (newline != NULL)
+    {
+      in->pos += newline - start + 1;
+      take_text(in, yarn, start, newline - start);
+      break;
+    }
+    in->pos = in->end;
+    take_text(in, yarn, start, avail);
+  }
+}
+
+/*!
+ * \brief GIMMEH WORD: skip blanks and read up to the next one
+ *
+ */
+static void read_word(lol_input_t *in, value_t *yarn)
+{
+  long avail;
+  yarn_clear(yarn);
+  while ((avail = fill_input(in)) > 0)
+  {
+    const char *start = in->buf + in->pos;
+    in->pos += find_blank(start, avail, 0) - start;
+    if (in->pos < in->end)
+      break;
+  }
+  if (avail == 0)
+    lol_exit(0);
+  while ((avail = fill_input(in)) > 0)
+  {
+    const char *start = in->buf + in->pos;
+    const char *end = find_blank(start, avail, 1);
+    in->pos += end - start;
+    take_text(in, yarn, start, end - start);
+    if (in->pos < in->end)
+      break;
+  }
+}
+
+/*!
+ * \brief GIMMEH LETTAR: read one character
+ *
+ */
+static void read_lettar(lol_input_t *in, value_t *yarn)
+{
+  yarn_clear(yarn);
+  if (fill_input(in) == 0)
+    lol_exit(0);
+  append_text(yarn, in->buf + in->pos, 1, 0);
+  ++in->pos;
+}
+
+/*!
+ * \brief GIMMEH from stdin
+ */
+LOL_REALIGN void lol_gimmeh_line(value_t *yarn)
+{
+  read_line(&inputs[0], yarn);
+}
+
+LOL_REALIGN void lol_gimmeh_word(value_t *yarn)
+{
+  read_word(&inputs[0], yarn);
+}
+
+LOL_REALIGN void lol_gimmeh_lettar(value_t *yarn)
+{
+  read_lettar(&inputs[0], yarn);
+}
+
+/*!
+ * \brief GIMMEH ... OUTTA a file, by the name in a YARN
+ */
+LOL_REALIGN void lol_gimmeh_line_from(value_t *yarn, const value_t *name)
+{
+  read_line(open_input(name), yarn);
+}
+
+LOL_REALIGN void lol_gimmeh_word_from(value_t *yarn, const value_t *name)
+{
+  read_word(open_input(name), yarn);
+}
+
+LOL_REALIGN void lol_gimmeh_lettar_from(value_t *yarn, const value_t *name)
+{
+  read_lettar(open_input(name), yarn);
+}
+
+/*!
+ * \brief Execution counts and cycles for one source line (see lcc -profile)
+ */
+typedef struct {
+  unsigned long long hits;
+  unsigned long long cycles;
+} lineprof_t;
+
+static const char *prof_file = NULL;
+static lineprof_t *prof_lines = NULL;
+static long prof_count = 0;
+static long prof_current = 0;
+static unsigned long long prof_last = 0;
+
+/*!
+ * \brief Start profiling (called once at the top of main)
+ */
+void lolprof_init(const char *file)
+{
+  prof_file = file;
+  prof_current = 0;
+  prof_last = __rdtsc();
+}
+
+/*!
+ * \brief Mark the start of the statement on a source line
+ *
+ * The cycles since the previous mark are charged to the previous line, so a
+ * line's cost is the time until the next statement starts.
+ */
+void lolprof_line(long line)
+{
+  unsigned long long now = __rdtsc();
+  if (line >= prof_count)
+  {
+    long count = (line+1 > prof_count*2) ? line+1 : prof_count*2;
+    prof_lines = (lineprof_t*)realloc(prof_lines, count*sizeof(lineprof_t));
+    if (prof_lines == NULL)
+    {
+      fprintf(stderr, "lolprof_line: Unable to allocate new memory! %ld bytes\n", count*sizeof(lineprof_t));
+      exit(1);
+    }
+    for (; prof_count < count; ++prof_count)
+    {
+      prof_lines[prof_count].hits = 0;
+      prof_lines[prof_count].cycles = 0;
+    }
+  }
+  prof_lines[prof_current].cycles += now - prof_last;
+  prof_lines[line].hits += 1;
+  prof_current = line;
+  prof_last = __rdtsc(); // don't charge the bookkeeping to anybody
+}
+
+/*!
+ * \brief Write the per-line report to stderr (lol_exit calls this)
+ *
+ * Nothing is written unless the program was profiled.
+ */
+void lolprof_dump()
+{
+  long line;
+  unsigned long long total = 0;
+
+  if (prof_lines == NULL)
+    return;
+  prof_lines[prof_current].cycles += __rdtsc() - prof_last;
+  for (line = 1; line < prof_count; ++line)
+    total += prof_lines[line].cycles;
+
+  fprintf(stderr, "%-20s %14s %16s %7s\n", "line", "hits", "cycles", "cost");
+  for (line = 1; line < prof_count; ++line)
+  {
+    if (prof_lines[line].hits == 0)
+      continue;
+    fprintf(stderr, "%-12s:%-7ld %14llu %16llu %6.2f%%\n", prof_file, line,
+            prof_lines[line].hits, prof_lines[line].cycles,
+            total ? 100.0 * prof_lines[line].cycles / total : 0.0);
   }
-  var->dims[dim_num] = new_length; 
-  var->vals = dimalloc(var->vals, var->dims, var->dim_cnt);
-  fprintf(stderr, "varalloc: var.vals@%p\n", var->vals);
 }
@@ -5,5 +5,127 @@
 #define TYPE_STRING      1
 #define TYPE_FLOAT       2
 #define TYPE_INTEGER     3
+#define TYPE_BUKKIT      4  /* some element may hold a nested BUKKIT */
+
+/*
+ * A YARN is kept right in its value_t.  The last byte is a tag: text of up to
+ * YARN_INLINE_MAX bytes is stored in the bytes before it (tagged YARN_INLINE
+ * or'ed with the length) and anything longer is a yarn_block_t that the low
+ * bytes point to (tagged YARN_HEAP).  An element that has been indexed itself
+ * (MAH MAH arr!!2!!1) holds a nested BUKKIT: its low bytes point to a
+ * variable_t (tagged VAL_BUKKIT).  A tag of 0 means the value is a NUMBR, a
+ * sub-array or nothing at all; the lol_yarn_* functions read it as the
+ * digits of a NUMBR.
+ *
+ * A line or word that GIMMEH read out of a mapped file is not copied: the
+ * first four bytes are where it starts in the file, the next two its length
+ * and the next one which file it was (tagged YARN_SLICE).
+ */
+#define YARN_INLINE      0x80
+#define YARN_SLICE       0x40
+#define YARN_HEAP        0x20
+#define VAL_BUKKIT       0x10
+#define YARN_INLINE_MAX  7
+
+/*
+ * How lol_bukkit_at is going to use the element it finds
+ */
+#define LOL_AT_STORE     1  /* stored to: make room for it */
+#define LOL_AT_BUKKIT    2  /* indexed: don't look inside a nested BUKKIT */
+
+/*!
+ * \brief The text of a YARN too long to be kept inline
+ */
+typedef struct {
+  long len;     /*!< Length of the text */
+  long cap;     /*!< Room for text (0 for a constant, which is never changed or freed) */
+  char text[1]; /*!< The text (followed by a '\0') */
+} yarn_block_t;
+
+/*!
+ * \brief Variable type
+ */
+typedef union _val_t {
+  char *val_string;
+  long val_integer;
+  double val_float;
+  union _val_t *val_array;
+  unsigned char val_bytes[8];
+} value_t;
+
+#define YARN_TAG(val)    ((val)->val_bytes[7])
+
+typedef struct _var_t {
+  long var_type;
+  long dim_cnt;
+  long *dims;
+  value_t *vals;
+  struct _var_t *scope_next; /*!< The variable allocated before this one */
+  struct _sparse_t *sparse;  /*!< The values when they are kept in a hash table (vals is NULL then) */
+} variable_t;
+
+/*!
+ * \brief What the runtime's memory pool has done (see LOL_MEMSTATS)
+ */
+typedef struct {
+  long allocs; /*!< Blocks handed out */
+  long reused; /*!< ... of which came off a free list */
+  long large;  /*!< ... of which were too big for the pool */
+  long frees;  /*!< Blocks given back */
+  long in_use; /*!< Bytes handed out and not given back */
+  long peak;   /*!< Most bytes ever in use */
+  long chunks; /*!< Chunks taken from malloc */
+} lol_memstats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *varalloc(long var_type, long dim_cnt);
+void *validx(value_t *val, long index);
+void *dimalloc(value_t *val, long *old_sizes, long *sizes, long count);
+void vardimalloc(variable_t *var, long dim_num, long new_length);
+void lol_scope_release(long count);
+value_t *lol_bukkit_at(variable_t *var, long index, long mode);
+value_t *lol_bukkit_sub(value_t *val, long index, long mode);
+value_t *lol_bukkit_span(variable_t *var, long start, long count, long mode);
+void lol_memstats(lol_memstats_t *stats);
+void lol_memstats_print(void);
+
+long lol_yarn_len(const value_t *yarn);
+const char *lol_yarn_text(const value_t *yarn);
+void lol_yarn_set(value_t *yarn, const char *text, long len);
+void lol_yarn_numbr(value_t *yarn, long number);
+void lol_yarn_copy(value_t *dst, const value_t *src);
+void lol_yarn_move(value_t *dst, value_t *src);
+void lol_yarn_append(value_t *dst, const value_t *src);
+void lol_yarn_concat(value_t *dst, const value_t *a, const value_t *b);
+long lol_yarn_cmp(const value_t *a, const value_t *b);
+long lol_value_numbr(const value_t *val);
+void lol_value_add(value_t *dst, const value_t *a, const value_t *b);
+void lol_value_append(value_t *dst, const value_t *src);
+long lol_value_cmp(const value_t *a, const value_t *b);
+void lol_yarn_free(value_t *yarn);
+
+void lol_print_numbr(long number);
+void lol_print_yarn(const value_t *yarn);
+void lol_print_newline(void);
+void lol_print_error(const value_t *yarn);
+void lol_flush(void);
+void lol_exit(long status);
+void lol_gimmeh_line(value_t *yarn);
+void lol_gimmeh_word(value_t *yarn);
+void lol_gimmeh_lettar(value_t *yarn);
+void lol_gimmeh_line_from(value_t *yarn, const value_t *name);
+void lol_gimmeh_word_from(value_t *yarn, const value_t *name);
+void lol_gimmeh_lettar_from(value_t *yarn, const value_t *name);
+
+void lolprof_init(const char *file);
+void lolprof_line(long line);
+void lolprof_dump();
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <malloc.h>
 
 // For constants
@@ -9,23 +10,173 @@
 const char * const * type_names = NULL;
 unsigned type_count = 0;
 
+// The node pool: chunks of 1 << AST_CHUNK_BITS nodes that never move
+ast_node **ast_chunks = NULL;
+static unsigned ast_chunk_count = 0;
+static unsigned ast_used = 0;
+
+// The text of the words and strings, by index
+char **ast_texts = NULL;
+static unsigned ast_text_count = 0;
+static unsigned ast_text_cap = 0;
+
+// Nodes and text slots that were freed, to be used again
+static unsigned ast_free_nodes = 0; // (linked through slots[0])
+static unsigned *ast_free_texts = NULL;
+static unsigned ast_free_text_count = 0;
+static unsigned ast_free_text_cap = 0;
+
+static ast_node *new_node()
+{
+  if (ast_free_nodes != 0)
+  {
+    ast_node *node = ast_at(ast_free_nodes);
+    unsigned self = node->self;
+    ast_free_nodes = node->slots[0];
+    memset(node, 0, sizeof(*node));
+    node->self = self;
+    return node;
+  }
+  if (ast_used == 0)
+    ast_used = 1; // index 0 is "no node"
+  if ((ast_used >> AST_CHUNK_BITS) == ast_chunk_count)
+  {
+    ast_chunks = realloc(ast_chunks, (ast_chunk_count + 1) * sizeof(ast_node*));
+    ast_chunks[ast_chunk_count++] = calloc(AST_CHUNK_MASK + 1, sizeof(ast_node));
+  }
+  ast_node *node = ast_at(ast_used);
+  node->self = ast_used++;
+  return node;
+}
+
 ast_node *create_ast_node(unsigned t, unsigned l, unsigned char term)
 {
   //printf("\n[[Creating %snode:%d:", (term?"terminal ":""), t);
   //fflush(stdout);
   //printf("%s]]\n", (type_names?type_names[t]:""));
-  ast_node *node = (ast_node*)calloc(1, sizeof(ast_node));
+  ast_node *node = new_node();
   node->type = t;
   node->lineno = l;
   node->terminal = term;
   return node;
 }
 
-void append_leaf(ast_node *i_node, void *leaf)
+static void append_slot(ast_node *node, unsigned kind, unsigned value)
+{
+  if (node->nodecount < AST_INLINE && node->nodecap == 0)
+  {
+    node->kinds |= kind << (2*node->nodecount);
+    node->slots[node->nodecount++] = value;
+    return;
+  }
+  if (kind != AST_NODE)
+  {
+    fprintf(stderr, "Only child nodes can go past slot %d of a node\n", AST_INLINE);
+    abort();
+  }
+  if (node->nodecap == 0)
+  {
+    // statement lists get long, so don't realloc on every append
+    unsigned *more = malloc(2*AST_INLINE * sizeof(unsigned));
+    memcpy(more, node->slots, sizeof(node->slots));
+    node->more = more;
+    node->nodecap = 2*AST_INLINE;
+  }
+  else if (node->nodecount == node->nodecap)
+  {
+    node->nodecap *= 2;
+    node->more = realloc(node->more, node->nodecap * sizeof(unsigned));
+  }
+  node->more[node->nodecount++] = value;
+}
+
+void append_leaf(ast_node *node, ast_node *leaf)
 {
-  ast_node *node = (ast_node*)i_node;
-  node->nodes = realloc(node->nodes, (node->nodecount + 1) * sizeof(void*));
-  node->nodes[node->nodecount++] = leaf;
+  append_slot(node, AST_NODE, leaf->self);
+}
+
+void append_char(ast_node *node, char c)
+{
+  append_slot(node, AST_CHAR, (unsigned char)c);
+}
+
+void append_int(ast_node *node, int value)
+{
+  append_slot(node, AST_INT, (unsigned)value);
+}
+
+void append_text(ast_node *node, char *text)
+{
+  unsigned index;
+  if (ast_free_text_count > 0)
+  {
+    index = ast_free_texts[--ast_free_text_count];
+  }
+  else
+  {
+    if (ast_text_count == ast_text_cap)
+    {
+      ast_text_cap = ast_text_cap ? ast_text_cap*2 : 256;
+      ast_texts = realloc(ast_texts, ast_text_cap * sizeof(char*));
+    }
+    index = ast_text_count++;
+  }
+  ast_texts[index] = text;
+  append_slot(node, AST_TEXT, index);
+}
+
+void free_ast_node(ast_node *node)
+{
+  unsigned n;
+  for (n = 0; n < node->nodecount && n < AST_INLINE; ++n)
+  {
+    if (ast_kind(node, n) != AST_TEXT)
+      continue;
+    unsigned index = ast_slot(node, n);
+    free(ast_texts[index]);
+    ast_texts[index] = NULL;
+    if (ast_free_text_count == ast_free_text_cap)
+    {
+      ast_free_text_cap = ast_free_text_cap ? ast_free_text_cap*2 : 256;
+      ast_free_texts = realloc(ast_free_texts, ast_free_text_cap * sizeof(unsigned));
+    }
+    ast_free_texts[ast_free_text_count++] = index;
+  }
+  if (node->nodecap)
+    free(node->more);
+  node->nodecap = 0;
+  node->nodecount = 0;
+  node->slots[0] = ast_free_nodes;
+  ast_free_nodes = node->self;
+}
+
+void free_ast_tree(ast_node *node)
+{
+  unsigned n;
+  for (n = 0; n < node->nodecount; ++n)
+  {
+    if (ast_kind(node, n) == AST_NODE && ast_slot(node, n) != 0)
+      free_ast_tree(ast_child(node, n));
+  }
+  free_ast_node(node);
+}
+
+void ast_reset()
+{
+  unsigned i;
+  for (i = 0; i < ast_text_count; ++i)
+    free(ast_texts[i]); // (NULL once freed)
+  for (i = 1; i < ast_used; ++i)
+  {
+    ast_node *node = ast_at(i);
+    if (node->nodecap)
+      free(node->more);
+    memset(node, 0, sizeof(*node));
+  }
+  ast_used = 1;
+  ast_free_nodes = 0;
+  ast_text_count = 0;
+  ast_free_text_count = 0;
 }
 
 void print_tree(ast_node *node, unsigned indent)
@@ -39,21 +190,31 @@ void print_tree(ast_node *node, unsigned indent)
   {
     ws(indent); printf("Huh? TN = %d/%d\n", node->type,type_count);
   }
-  ws(indent); printf("{%s:%ld:%d:%p}\n", type_names[node->type], node->lineno, node->nodecount, node->nodes);
-  if (node->terminal == 0)
+  ws(indent); printf("{%s:%u:%u:#%u}\n", type_names[node->type], node->lineno, node->nodecount, node->self);
+  unsigned n;
+  for (n = 0; n < node->nodecount; ++n)
   {
-    unsigned n;
-    for (n = 0; n < node->nodecount; ++n)
+    switch (ast_kind(node, n))
     {
-      if (node->nodes[n])
-      {
-        print_tree(node->nodes[n], indent+2);
-      }
-      else
-      {
-        ws(indent+2); printf("Uh ho! NULL\n");
-      }
+      case AST_NODE:
+        if (ast_slot(node, n))
+        {
+          print_tree(ast_child(node, n), indent+2);
+        }
+        else
+        {
+          ws(indent+2); printf("Uh ho! NULL\n");
+        }
+        break;
+      case AST_CHAR:
+        ws(indent+2); printf("'%c'\n", ast_char(node, n));
+        break;
+      case AST_INT:
+        ws(indent+2); printf("%d\n", ast_int(node, n));
+        break;
+      case AST_TEXT:
+        ws(indent+2); printf("\"%s\"\n", ast_text(node, n));
+        break;
     }
   }
-  //ws(indent+2),printf("<terminal>\n");
 }
@@ -8,12 +8,42 @@
 // For constants
 #include "grammar.tab.h"
 
+/*
+ * The nodes all live in one pool (see ast.c) and refer to each other by
+ * their 32-bit index in it, so a tree is a few contiguous chunks of 32-byte
+ * nodes instead of a node, a child array and a leaf allocation per token.
+ * Index 0 is never used, so it can stand for "no node".
+ *
+ * A node has a list of slots (its leaves).  Most hold a child node, but an
+ * operator or other one-character tag ('+', 'W', ...), a number and the
+ * text of a word or string are held right in the slot; the kind of each of
+ * the first AST_INLINE slots is kept in the node.  Only statement lists have
+ * more slots than that, and theirs are all child nodes, kept in an array of
+ * their own.
+ */
+
+#define AST_INLINE      3   // slots kept in the node itself
+#define AST_CHUNK_BITS  12  // 4096 nodes (128KB) per chunk of the pool
+#define AST_CHUNK_MASK  ((1u << AST_CHUNK_BITS) - 1)
+
+// What a slot holds
+#define AST_NODE  0  // the index of a child node
+#define AST_CHAR  1  // a character
+#define AST_INT   2  // a number
+#define AST_TEXT  3  // the index of some text in ast_texts
+
 typedef struct ast_node_t {
+  unsigned short type;
   unsigned char terminal; // boolean (1/0)
-  unsigned type;
-  unsigned nodecount;
-  unsigned long lineno;
-  void **nodes;
+  unsigned char kinds;    // what each inline slot holds (2 bits each, first slot lowest)
+  unsigned lineno;
+  unsigned nodecount;     // slots used
+  unsigned nodecap;       // room in more (0 while the slots fit in the node)
+  union {
+    unsigned slots[AST_INLINE];
+    unsigned *more;       // (grows by doubling)
+  };
+  unsigned self;          // this node's index
 } ast_node;
 
 extern const char * const * type_names;
@@ -23,15 +53,76 @@ extern unsigned type_count;
 extern "C" {
 #endif
 
+extern ast_node **ast_chunks;
+extern char **ast_texts;
+
 ast_node *create_ast_node(unsigned t, unsigned l, unsigned char term);
 
-void append_leaf(ast_node *node, void *leaf);
+void append_leaf(ast_node *node, ast_node *leaf);
+void append_char(ast_node *node, char c);
+void append_int(ast_node *node, int value);
+void append_text(ast_node *node, char *text);
+
+// Give a node (and its text) back to the pool, or a node and everything under it
+void free_ast_node(ast_node *node);
+void free_ast_tree(ast_node *node);
+
+// Give every node back to the pool at once (it keeps its memory for the next tree)
+void ast_reset();
 
 void print_tree(ast_node *node, unsigned indent);
 
-// NOTE! THIS IS NOT IN AST.C
+// NOTE! THESE ARE NOT IN AST.C
 ast_node *generate_ast();
 
+// Parse one top-level statement at a time (see grammar.y)
+extern unsigned long program_lineno;
+void stream_ast_open();
+ast_node *stream_ast_next();
+int stream_ast_close();
+
+/* The node at an index in the pool */
+static inline ast_node *ast_at(unsigned index)
+{
+  return &ast_chunks[index >> AST_CHUNK_BITS][index & AST_CHUNK_MASK];
+}
+
+/* The raw contents of a slot */
+static inline unsigned ast_slot(const ast_node *node, unsigned i)
+{
+  return node->nodecap ? node->more[i] : node->slots[i];
+}
+
+/* What a slot holds (AST_NODE, ...) */
+static inline unsigned ast_kind(const ast_node *node, unsigned i)
+{
+  return (i < AST_INLINE) ? (node->kinds >> (2*i)) & 3 : AST_NODE;
+}
+
+/* The child node in a slot */
+static inline ast_node *ast_child(const ast_node *node, unsigned i)
+{
+  return ast_at(ast_slot(node, i));
+}
+
+/* The character in a slot */
+static inline char ast_char(const ast_node *node, unsigned i)
+{
+  return (char)ast_slot(node, i);
+}
+
+/* The number in a slot */
+static inline int ast_int(const ast_node *node, unsigned i)
+{
+  return (int)ast_slot(node, i);
+}
+
+/* The text in a slot */
+static inline const char *ast_text(const ast_node *node, unsigned i)
+{
+  return ast_texts[ast_slot(node, i)];
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -42,6 +133,9 @@ ast_node *generate_ast();
 #define AL(x,y) append_leaf(x,y)
 #define ALL(x,y,z) AL(x,y),AL(x,z)
 #define ALLL(x,y,z,w) ALL(x,y,z),AL(x,w)
+#define ALC(x,c) append_char(x,c)
+#define ALI(x,n) append_int(x,n)
+#define ALT(x,t) append_text(x,t)
 
 // Print white space
 #define ws(c) { int _local_i; for (_local_i = 0; _local_i < c; ++_local_i) printf(" "); }
@@ -0,0 +1,341 @@
+/*! \file Microbenchmarks for the runtime helpers in asmutil.c
+ *
+ * Built natively (without -m32) against asmutil.c with tracing turned off,
+ * and against memstat.c so that heap allocations can be counted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "asmutil.h"
+#include "memstat.h"
+
+/*!
+ * \brief What one benchmark run cost
+ */
+typedef struct {
+  double seconds;
+  unsigned long ops;
+  memstat_t before;
+  struct timespec start;
+} bench_t;
+
+static volatile long sink; /* keeps results alive */
+
+static void bench_start(bench_t *b)
+{
+  b->ops = 0;
+  memstat_get(&b->before);
+  clock_gettime(CLOCK_MONOTONIC, &b->start);
+}
+
+/*!
+ * \brief Stop the clock and print one line of results
+ */
+static void bench_end(bench_t *b, const char *name, const char *param)
+{
+  struct timespec end;
+  memstat_t after;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  memstat_get(&after);
+  b->seconds = (end.tv_sec - b->start.tv_sec) + (end.tv_nsec - b->start.tv_nsec) / 1e9;
+  printf("%-12s %-18s %12lu %12.1f %12.3f %14.1f\n", name, param, b->ops,
+         b->seconds * 1e9 / b->ops,
+         (double)(after.allocs - b->before.allocs) / b->ops,
+         (double)(after.bytes - b->before.bytes) / b->ops);
+}
+
+/*!
+ * \brief xorshift, so random access patterns are the same run to run
+ */
+static unsigned long next_random(unsigned long *state)
+{
+  unsigned long x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return (*state = x);
+}
+
+/*!
+ * \brief I HAS A: varalloc plus the first vardimalloc of a one element variable
+ */
+static void bench_declare(unsigned long n)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i;
+  snprintf(param, sizeof(param), "n=%lu", n);
+  bench_start(&b);
+  for (i = 0; i < n; ++i)
+  {
+    variable_t *var = varalloc(TYPE_IDK, 1);
+    vardimalloc(var, 0, 1);
+    sink += (long)var->vals;
+    ++b.ops;
+  }
+  bench_end(&b, "declare", param);
+}
+
+/*!
+ * \brief A loop body that declares vars variables, run n times (each pass
+ * releases them again at the end, like leaving the block)
+ */
+static void bench_scope(unsigned long n, long vars)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i;
+  long v;
+  snprintf(param, sizeof(param), "n=%lu vars=%ld", n, vars);
+  bench_start(&b);
+  for (i = 0; i < n; ++i)
+  {
+    for (v = 0; v < vars; ++v)
+    {
+      variable_t *var = varalloc(TYPE_IDK, 1);
+      vardimalloc(var, 0, 1);
+      sink += (long)var->vals;
+      ++b.ops;
+    }
+    lol_scope_release(vars);
+  }
+  bench_end(&b, "scope", param);
+}
+
+/*!
+ * \brief Grow a one dimensional array one element at a time up to n
+ */
+static void bench_extend(unsigned long n)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i;
+  variable_t *var = varalloc(TYPE_INTEGER, 1);
+  snprintf(param, sizeof(param), "n=%lu", n);
+  bench_start(&b);
+  for (i = 1; i <= n; ++i)
+  {
+    vardimalloc(var, 0, i);
+    ++b.ops;
+  }
+  bench_end(&b, "extend", param);
+  sink += var->vals[n-1].val_integer;
+}
+
+/*!
+ * \brief Store to every stride'th element of a BUKKIT, n stores in all, then
+ * read them all back
+ */
+static void bench_store(unsigned long n, long stride)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i;
+  long sum = 0;
+  variable_t *var = varalloc(TYPE_INTEGER, 1);
+  vardimalloc(var, 0, 1);
+  snprintf(param, sizeof(param), "n=%lu stride=%ld", n, stride);
+  bench_start(&b);
+  for (i = 0; i < n; ++i)
+  {
+    lol_bukkit_at(var, i * stride, LOL_AT_STORE)->val_integer = i;
+    ++b.ops;
+  }
+  for (i = 0; i < n; ++i)
+  {
+    sum += lol_bukkit_at(var, i * stride, 0)->val_integer;
+    ++b.ops;
+  }
+  bench_end(&b, "store", param);
+  lol_scope_release(1);
+  sink += sum;
+}
+
+/*!
+ * \brief Store to n random elements of a BUKKIT of up to range elements,
+ * then read as many random elements
+ */
+static void bench_scatter(unsigned long n, unsigned long range)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i, state = 88172645463325252ul;
+  long sum = 0;
+  variable_t *var = varalloc(TYPE_INTEGER, 1);
+  vardimalloc(var, 0, 1);
+  snprintf(param, sizeof(param), "n=%lu range=%lu", n, range);
+  bench_start(&b);
+  for (i = 0; i < n; ++i)
+  {
+    lol_bukkit_at(var, next_random(&state) % range, LOL_AT_STORE)->val_integer = i;
+    ++b.ops;
+  }
+  for (i = 0; i < n; ++i)
+  {
+    sum += lol_bukkit_at(var, next_random(&state) % range, 0)->val_integer;
+    ++b.ops;
+  }
+  bench_end(&b, "scatter", param);
+  lol_scope_release(1);
+  sink += sum;
+}
+
+/*!
+ * \brief Read random elements of an array of n values
+ */
+static void bench_random(unsigned long n, unsigned long ops)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i, state = 88172645463325252ul;
+  long sum = 0;
+  variable_t *var = varalloc(TYPE_INTEGER, 1);
+  vardimalloc(var, 0, n);
+  for (i = 0; i < n; ++i)
+    var->vals[i].val_integer = i;
+  snprintf(param, sizeof(param), "n=%lu", n);
+  bench_start(&b);
+  for (i = 0; i < ops; ++i)
+  {
+    value_t *val = validx(var->vals, next_random(&state) % n);
+    sum += val->val_integer;
+    ++b.ops;
+  }
+  bench_end(&b, "random", param);
+  sink += sum;
+}
+
+/*!
+ * \brief Grow every dimension of a dims-dimensional array in turn up to size
+ */
+static void bench_resize(long dims, long size)
+{
+  bench_t b;
+  char param[32];
+  long s, d;
+  variable_t *var = varalloc(TYPE_INTEGER, dims);
+  snprintf(param, sizeof(param), "dims=%ld size=%ld", dims, size);
+  bench_start(&b);
+  for (s = 1; s <= size; ++s)
+  {
+    for (d = 0; d < dims; ++d)
+    {
+      vardimalloc(var, d, s);
+      ++b.ops;
+    }
+  }
+  bench_end(&b, "resize", param);
+  sink += (long)var->vals;
+}
+
+/*!
+ * \brief UPZ LINE!!"...": append a len byte YARN to one YARN n times
+ */
+static void bench_append(unsigned long n, long len)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i;
+  value_t line = {0}, piece = {0};
+  lol_yarn_set(&piece, "abcdefghijklmnopqrstuvwxyz", len);
+  snprintf(param, sizeof(param), "n=%lu len=%ld", n, len);
+  bench_start(&b);
+  for (i = 0; i < n; ++i)
+  {
+    lol_yarn_append(&line, &piece);
+    ++b.ops;
+  }
+  bench_end(&b, "append", param);
+  sink += lol_yarn_len(&line);
+  lol_yarn_free(&line);
+  lol_yarn_free(&piece);
+}
+
+/*!
+ * \brief LOL X R UP A AN B: concatenate two len byte YARNs into a temporary
+ */
+static void bench_concat(unsigned long n, long len)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i;
+  value_t a = {0}, c = {0};
+  lol_yarn_set(&a, "abcdefghijklmnopqrstuvwxyz", len);
+  snprintf(param, sizeof(param), "n=%lu len=%ld", n, len);
+  bench_start(&b);
+  for (i = 0; i < n; ++i)
+  {
+    lol_yarn_concat(&c, &a, &a);
+    sink += lol_yarn_len(&c);
+    lol_yarn_free(&c);
+    ++b.ops;
+  }
+  bench_end(&b, "concat", param);
+  lol_yarn_free(&a);
+}
+
+/*!
+ * \brief LIEK on two equal len byte YARNs
+ */
+static void bench_compare(unsigned long n, long len)
+{
+  bench_t b;
+  char param[32];
+  unsigned long i;
+  value_t x = {0}, y = {0};
+  lol_yarn_set(&x, "abcdefghijklmnopqrstuvwxyz", len);
+  lol_yarn_set(&y, "abcdefghijklmnopqrstuvwxyz", len);
+  snprintf(param, sizeof(param), "n=%lu len=%ld", n, len);
+  bench_start(&b);
+  for (i = 0; i < n; ++i)
+  {
+    sink += lol_yarn_cmp(&x, &y);
+    ++b.ops;
+  }
+  bench_end(&b, "compare", param);
+  lol_yarn_free(&x);
+  lol_yarn_free(&y);
+}
+
+int main(int argc, char **argv)
+{
+  printf("%-12s %-18s %12s %12s %12s %14s\n", "benchmark", "parameters", "ops", "ns/op", "allocs/op", "bytes/op");
+
+  bench_declare(100000);
+  bench_declare(1000000);
+
+  bench_scope(1000000, 1);
+  bench_scope(100000, 16);
+
+  bench_extend(1000);
+  bench_extend(4000);
+  bench_extend(16000);
+
+  bench_store(1000000, 1);
+  bench_store(100000, 1000);
+
+  bench_scatter(100000, 10000000);
+  bench_scatter(1000000, 100000000);
+
+  bench_random(1000, 10000000);
+  bench_random(100000, 10000000);
+  bench_random(10000000, 10000000);
+
+  bench_resize(2, 64);
+  bench_resize(3, 24);
+  bench_resize(4, 12);
+
+  bench_append(1000000, 1);
+  bench_append(1000000, 20);
+
+  bench_concat(1000000, 3);
+  bench_concat(1000000, 20);
+
+  bench_compare(10000000, 5);
+  bench_compare(10000000, 26);
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+#include <string>
+using std::string;
+
+#include <sstream>
+using std::ostringstream;
+
+#include "corpus.hpp"
+
+namespace LOLBench
+{
+  /*!
+   * \brief N variable declarations
+   *
+   * Every declaration adds a new symbol to the current variable context
+   */
+
+  static void gen_decls(ostringstream &out, unsigned long n)
+  {
+    for (unsigned long i = 0; i < n; ++i)
+      out << "I HAS A V" << i << " ITZ " << i << "\n";
+  }
+
+  /*!
+   * \brief N nested blocks
+   *
+   * Alternates IZ and IM IN YR so both the conditional and the loop hooks
+   * recurse.  Nothing is indented so the input stays linear in N.
+   */
+
+  static void gen_nest(ostringstream &out, unsigned long n)
+  {
+    for (unsigned long d = 0; d < n; ++d)
+    {
+      if (d % 2 == 0)
+        out << "IZ WIN\n";
+      else
+        out << "IM IN YR L" << d << "\n";
+    }
+    out << "VISIBLE 1\n";
+    for (unsigned long d = n; d > 0; --d)
+    {
+      if ((d-1) % 2 == 0)
+        out << "KTHX\n";
+      else
+        out << "GTFO\nLOL\n";
+    }
+  }
+
+  /*!
+   * \brief One VISIBLE of an N character YARN
+   */
+
+  static void gen_yarn(ostringstream &out, unsigned long n)
+  {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrstuvwxyz ";
+    string yarn(n, ' ');
+    for (unsigned long i = 0; i < n; ++i)
+      yarn[i] = alphabet[i % (sizeof(alphabet)-1)];
+    out << "VISIBLE \"" << yarn << "\"\n";
+  }
+
+  /*!
+   * \brief One assignment through N levels of MAH indexing
+   */
+
+  static void gen_mah(ostringstream &out, unsigned long n)
+  {
+    out << "I HAS A X\n";
+    out << "LOL ";
+    for (unsigned long i = 0; i < n; ++i)
+      out << "MAH ";
+    out << "X";
+    for (unsigned long i = 0; i < n; ++i)
+      out << "!!0";
+    out << " R 1\n";
+  }
+
+  /*!
+   * \brief N straight-line statements
+   *
+   * A mix of assignment, self-assignment, output and comments
+   */
+
+  static void gen_stmts(ostringstream &out, unsigned long n)
+  {
+    out << "I HAS A CNT ITZ 0\n";
+    out << "I HAS A STEP ITZ 1\n";
+    for (unsigned long i = 0; i < n; ++i)
+    {
+      switch (i % 4)
+      {
+        case 0: out << "LOL CNT R UP CNT AN STEP\n"; break;
+        case 1: out << "UPZ STEP!!\n"; break;
+        case 2: out << "VISIBLE CNT\n"; break;
+        case 3: out << "BTW statement " << i << "\n"; break;
+      }
+    }
+  }
+
+  const Shape shapes[] = {
+    { "decls", "N declarations (I HAS A)", 2000 },
+    { "nest",  "N nested IZ/IM IN YR blocks", 500 },
+    { "yarn",  "one VISIBLE of an N character YARN", 100000 },
+    { "mah",   "one assignment through N MAH indices", 500 },
+    { "stmts", "N straight-line statements", 20000 },
+    { NULL, NULL, 0 }
+  };
+
+  /*!
+   * \param name The name of the shape you're looking for
+   * \return The shape, or NULL if there is no such shape
+   */
+  const Shape *shape_search(string name)
+  {
+    for (unsigned i = 0; shapes[i].name != NULL; ++i)
+    {
+      if (name == shapes[i].name)
+        return &shapes[i];
+    }
+    return NULL;
+  }
+
+  /*!
+   * \param shape The shape of program to generate
+   * \param n The size of the program
+   * \return The source of a complete program (HAI through KTHXBYE)
+   */
+  string generate(const Shape *shape, unsigned long n)
+  {
+    ostringstream out;
+    string name = shape->name;
+    out << "HAI\n";
+    if (name == "decls")
+      gen_decls(out, n);
+    else if (name == "nest")
+      gen_nest(out, n);
+    else if (name == "yarn")
+      gen_yarn(out, n);
+    else if (name == "mah")
+      gen_mah(out, n);
+    else if (name == "stmts")
+      gen_stmts(out, n);
+    out << "KTHXBYE\n";
+    return out.str();
+  }
+}
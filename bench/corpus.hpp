@@ -0,0 +1,41 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <string>
+
+/*!
+ * \brief Synthetic LOLCODE corpus generation for the benchmarks
+ *
+ *   Each shape stresses one part of the compiler and scales linearly in
+ * the size of the input with N, so any super-linear growth in the time a
+ * phase takes is the compiler's fault and not the corpus'.
+ */
+
+namespace LOLBench
+{
+  using std::string;
+
+  /*!
+   * \brief A shape of synthetic program
+   */
+  typedef struct {
+    const char *name;        /*!< The name used to select this shape */
+    const char *description; /*!< What the shape stresses */
+    unsigned long base;      /*!< A reasonable starting N */
+  } Shape;
+
+  /*! A list of the known shapes (terminated by a NULL name) */
+  extern const Shape shapes[];
+
+  /*!
+   * \brief Search for a shape by name
+   */
+  const Shape *shape_search(string name);
+
+  /*!
+   * \brief Generate a program of the given shape and size
+   */
+  string generate(const Shape *shape, unsigned long n);
+}
+
+#endif
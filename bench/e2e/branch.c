@@ -0,0 +1,32 @@
+/* branch.lol */
+#include <stdio.h>
+
+int main(void)
+{
+  int n = 5000000;
+  int fizz = 0, buzz = 0, fizzbuzz = 0, other = 0, big = 0;
+  int i;
+  for (i = 1; i <= n; ++i)
+  {
+    int r3 = i - (i/3)*3;
+    int r5 = i - (i/5)*5;
+    if (r3 == 0)
+    {
+      if (r5 == 0)
+        ++fizzbuzz;
+      else
+        ++fizz;
+    }
+    else
+    {
+      if (r5 == 0)
+        ++buzz;
+      else if (i > 2500000)
+        ++big;
+      else
+        ++other;
+    }
+  }
+  printf("%d\n%d\n%d\n%d\n%d\n", fizz, buzz, fizzbuzz, other, big);
+  return 0;
+}
@@ -0,0 +1,17 @@
+/* count.lol */
+#include <stdio.h>
+
+int main(void)
+{
+  int counter = 0, target = 20000000;
+  unsigned sum = 0; /* (wraps like a NUMBR) */
+  while (1)
+  {
+    if (counter > target)
+      break;
+    sum += counter;
+    ++counter;
+  }
+  printf("%d\n", (int)sum);
+  return 0;
+}
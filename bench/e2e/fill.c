@@ -0,0 +1,26 @@
+/* fill.lol */
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(void)
+{
+  int n = 100000, passes = 50;
+  int *arr = calloc(n, sizeof(int));
+  unsigned sum = 0; /* (wraps like a NUMBR) */
+  int biggest = 0;
+  int pass, i;
+  for (pass = 0; pass < passes; ++pass)
+  {
+    for (i = 0; i < n; ++i)
+      arr[i] = i*7 + pass;
+    for (i = 0; i < n; ++i)
+    {
+      sum += arr[i];
+      if (arr[i] > biggest)
+        biggest = arr[i];
+    }
+  }
+  printf("%d\n%d\n", (int)sum, biggest);
+  free(arr);
+  return 0;
+}
@@ -0,0 +1,29 @@
+/* matrix.lol */
+#include <stdio.h>
+
+#define N 300
+
+static int m[N][N];
+
+int main(void)
+{
+  int passes = 30;
+  unsigned rows = 0, cols = 0; /* (wrap like NUMBRs) */
+  int pass, i, j;
+  for (pass = 0; pass < passes; ++pass)
+  {
+    for (i = 0; i < N; ++i)
+      for (j = 0; j < N; ++j)
+        m[i][j] = i*j + pass;
+    for (i = 0; i < N; ++i)
+    {
+      for (j = 0; j < N; ++j)
+      {
+        rows += m[i][j];
+        cols += (unsigned)m[j][i] * i;
+      }
+    }
+  }
+  printf("%d\n%d\n", (int)rows, (int)cols);
+  return 0;
+}
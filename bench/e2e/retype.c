@@ -0,0 +1,32 @@
+/* retype.lol */
+#include <stdio.h>
+
+int main(void)
+{
+  int n = 1000000;
+  int v = 0, v_fizz = 0; /* v holds "FIZZ" when v_fizz is set */
+  int fizz = 0, big = 0, sum = 0;
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    if (v_fizz)
+    {
+      fputs("FIZZ\n", stdout);
+      ++fizz;
+    }
+    else
+      printf("%d\n", v);
+    if (i - (i/3)*3 == 0)
+      v_fizz = 1;
+    else
+    {
+      v_fizz = 0;
+      v = i;
+      if (v > 500000)
+        ++big;
+      sum += v - (v/7)*7;
+    }
+  }
+  printf("%d\n%d\n%d\n", fizz, big, sum);
+  return 0;
+}
@@ -0,0 +1,17 @@
+/* visible.lol */
+#include <stdio.h>
+
+int main(void)
+{
+  int n = 2000000;
+  const char *msg = "LINE ";
+  int i;
+  for (i = 0; i < n; ++i)
+  {
+    fputs(msg, stdout);
+    printf("%d", i);
+    fputs(" OF ", stdout);
+    printf("%d\n", n);
+  }
+  return 0;
+}
@@ -0,0 +1,210 @@
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#include <iomanip>
+using std::setw;
+using std::setprecision;
+
+#include <string>
+using std::string;
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <getopt.h>
+#include <unistd.h>
+
+/*!
+ * \brief A LOLCODE program and the C program that does the same thing
+ *
+ *   Both are in the source directory (see -s) as <name>.lol and <name>.c, and
+ * must print the same thing.
+ */
+typedef struct {
+  const char *name;   /*!< The name of the programs (and used to select them) */
+  const char *about;  /*!< What they exercise */
+} Program;
+
+static const Program programs[] = {
+  { "count",   "Counting loop (like examples/counter.lol)" },
+  { "fill",    "Fill a BUKKIT and scan it" },
+  { "branch",  "Nested conditionals" },
+  { "visible", "VISIBLE a YARN and NUMBRs on every line" },
+  { "matrix",  "Two-dimensional MAH indexing" },
+  { "retype",  "A variable that is a YARN on some branches and a NUMBR on others" },
+  { NULL, NULL }
+};
+
+/*!
+ * \brief Get a monotonic time in seconds
+ */
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*!
+ * \brief Run a program, keeping the best time and its output
+ *
+ * \return The best time in seconds, or a negative number if it failed
+ */
+
+static double run(const string &binary, unsigned reps, string &output)
+{
+  double best = -1;
+  for (unsigned r = 0; r < reps; ++r)
+  {
+    double start = now();
+    FILE *p = popen((binary + " 2>/dev/null").c_str(), "r");
+    if (p == NULL)
+      return -1;
+    char buf[65536];
+    size_t got;
+    output.clear();
+    while ((got = fread(buf, 1, sizeof(buf), p)) > 0)
+      output.append(buf, got);
+    if (pclose(p) != 0)
+      return -1;
+    double seconds = now() - start;
+    if (best < 0 || seconds < best)
+      best = seconds;
+  }
+  return best;
+}
+
+/*!
+ * Print usage statement
+ */
+
+void usage(const char *progname)
+{
+  cerr << "Usage: " << progname << " [-k program] [-r reps] [-l command] [-c command] [-s dir] [-d dir] [-x ratio]" << endl;
+  cerr << "  -k <program> Only run this program (default: all)" << endl;
+  cerr << "  -r <reps>    Keep the best of this many runs (default: 3)" << endl;
+  cerr << "  -l <command> Command to compile LOLCODE with; \"-o <file> < <file>.lol\" is appended" << endl;
+  cerr << "               (default: ./lcc -F -rt bench/liblolrt_notrace.a)" << endl;
+  cerr << "  -c <command> Command to compile C with; \"<file>.c -o <file>\" is appended" << endl;
+  cerr << "               (default: gcc -m32 -O2)" << endl;
+  cerr << "  -s <dir>     Where the programs are (default: bench/e2e)" << endl;
+  cerr << "  -d <dir>     Where to put the executables (default: /tmp)" << endl;
+  cerr << "  -x <ratio>   Fail if a LOLCODE program is more than <ratio> times slower than C" << endl;
+  cerr << "Programs:" << endl;
+  for (unsigned i = 0; programs[i].name != NULL; ++i)
+    cerr << "  " << programs[i].name << string(10 - string(programs[i].name).size(), ' ')
+         << programs[i].about << endl;
+  exit(1);
+}
+
+/*!
+ * Program execution entry point
+ *
+ * Exits with 1 if a program failed to build or run, if the LOLCODE and C
+ * programs disagree, or if one is slower than -x allows.
+ */
+
+int main(int argc, char **argv)
+{
+  static const char *options = "k:r:l:c:s:d:x:";
+
+  const char *only = NULL;
+  unsigned reps = 3;
+  string lcc = "./lcc -F -rt bench/liblolrt_notrace.a";
+  string cc = "gcc -m32 -O2";
+  string source = "bench/e2e";
+  string dir = "/tmp";
+  double max_ratio = 0;
+
+  // option parsing
+  while (true)
+  {
+    int c = getopt(argc, argv, options);
+    if (c == -1) break;
+    switch (c)
+    {
+      case 'k':
+        only = optarg;
+        break;
+      case 'r':
+        reps = std::max(1ul, strtoul(optarg, NULL, 10));
+        break;
+      case 'l':
+        lcc = optarg;
+        break;
+      case 'c':
+        cc = optarg;
+        break;
+      case 's':
+        source = optarg;
+        break;
+      case 'd':
+        dir = optarg;
+        break;
+      case 'x':
+        max_ratio = strtod(optarg, NULL);
+        break;
+      default:
+        usage(*argv);
+        break;
+    }
+  }
+
+  bool ok = true;
+  cout << std::fixed;
+  cout << setw(10) << std::left << "program" << std::right
+       << setw(12) << "C ms" << setw(12) << "LOL ms" << setw(10) << "ratio" << endl;
+  for (unsigned k = 0; programs[k].name != NULL; ++k)
+  {
+    if (only != NULL && strcmp(only, programs[k].name) != 0)
+      continue;
+    string src = source + "/" + programs[k].name;
+    string base = dir + "/e2ebench-" + std::to_string(getpid()) + "-" + programs[k].name;
+    string builds[2] = {
+      cc + " " + src + ".c -o " + base + "-c",
+      lcc + " -o " + base + "-lol < " + src + ".lol"
+    };
+    const char *suffixes[2] = { "-c", "-lol" };
+    double seconds[2];
+    string outputs[2];
+    bool built = true;
+    for (int v = 0; v < 2 && built; ++v)
+    {
+      string binary = base + suffixes[v];
+      if (system(builds[v].c_str()) != 0 ||
+          (seconds[v] = run(binary, reps, outputs[v])) < 0)
+      {
+        cerr << programs[k].name << ": could not build or run " << binary << endl;
+        built = false;
+      }
+      unlink(binary.c_str());
+    }
+    if (!built)
+    {
+      ok = false;
+      continue;
+    }
+    if (outputs[0] != outputs[1])
+    {
+      cerr << programs[k].name << ": the LOLCODE program's output differs from the C program's" << endl;
+      ok = false;
+      continue;
+    }
+
+    double ratio = seconds[1] / seconds[0];
+    cout << setw(10) << std::left << programs[k].name << std::right << setprecision(1)
+         << setw(12) << seconds[0] * 1e3 << setw(12) << seconds[1] * 1e3
+         << setprecision(2) << setw(9) << ratio << "x" << endl;
+    if (max_ratio > 0 && ratio > max_ratio)
+    {
+      cerr << programs[k].name << ": " << ratio << " times slower than C (limit " << max_ratio << ")" << endl;
+      ok = false;
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,386 @@
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#include <iomanip>
+using std::setw;
+using std::setprecision;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <ctime>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "lolcode.hpp"
+using namespace LOLCode;
+
+#include "corpus.hpp"
+using namespace LOLBench;
+
+#include "ast.h"
+#include "fastlex.h"
+
+extern "C"
+{
+  int yylex();
+  void yyrestart(FILE *input_file);
+  extern unsigned long curline;
+  extern unsigned long lineno;
+}
+
+/*!
+ * \brief The phases of compilation that are timed separately
+ */
+enum { PHASE_LEX, PHASE_PARSE, PHASE_CODEGEN, PHASE_WRITE, PHASE_COUNT };
+
+static const char * const phase_names[PHASE_COUNT] = { "lex", "parse", "codegen", "write" };
+
+/*!
+ * \brief The outcome of compiling one program (written over a pipe by the child)
+ */
+typedef struct {
+  double seconds[PHASE_COUNT]; /*!< Best time for each phase */
+  unsigned long bytes;         /*!< Size of the input */
+  unsigned long tokens;        /*!< Tokens in the input */
+  int reached;                 /*!< Number of phases that completed */
+  char note[128];              /*!< Why a phase did not complete */
+} Result;
+
+/*!
+ * \brief Get a monotonic time in seconds
+ */
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*!
+ * \brief Point the scanner at the start of a file
+ */
+
+static void rewind_input(FILE *f)
+{
+  rewind(f);
+  if (use_fastlex)
+    fastlex_open(f);
+  else
+    yyrestart(f);
+  curline = 1;
+  lineno = 0;
+}
+
+/*!
+ * \brief Compile one program, keeping the best time of each phase
+ *
+ * This is run in a child process so that a crash (i.e. running out of C stack
+ * on a deep tree) or a leak in one measurement does not affect the others.
+ * Parsing pulls its tokens from the scanner, so the parse time reported is
+ * the time spent in yyparse() less the time it took to lex the same input.
+ *
+ * \param source The program to compile
+ * \param reps The number of times to repeat each measurement
+ * \param result Where to store the timings
+ */
+
+static void measure(const string &source, unsigned reps, Result &result)
+{
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  if (in == NULL || out == NULL)
+  {
+    snprintf(result.note, sizeof(result.note), "tmpfile: %s", strerror(errno));
+    return;
+  }
+  fwrite(source.data(), 1, source.size(), in);
+  fflush(in);
+  result.bytes = source.size();
+
+  for (unsigned r = 0; r < reps; ++r)
+  {
+    double phase[PHASE_COUNT];
+    double start;
+    int token;
+
+    result.reached = 0;
+
+    rewind_input(in);
+    result.tokens = 0;
+    start = now();
+    while ((token = yylex()) != 0)
+    {
+      if (token == T_WORD || token == T_STRING)
+        free(yylval.str);
+      ++result.tokens;
+    }
+    phase[PHASE_LEX] = now() - start;
+    result.reached = PHASE_LEX+1;
+
+    rewind_input(in);
+    start = now();
+    ASTNode *root = generate_ast();
+    phase[PHASE_PARSE] = std::max(0.0, now() - start - phase[PHASE_LEX]);
+    if (root == NULL)
+    {
+      snprintf(result.note, sizeof(result.note), "no valid A.S.T. generated");
+      break;
+    }
+    result.reached = PHASE_PARSE+1;
+
+    CompilerContext context;
+    start = now();
+    try
+    {
+      run_hook(root, context);
+    }
+    catch (HookError e)
+    {
+      snprintf(result.note, sizeof(result.note), "%s", e.to_string().c_str());
+      break;
+    }
+    phase[PHASE_CODEGEN] = now() - start;
+    result.reached = PHASE_CODEGEN+1;
+
+    start = now();
+    rewind(out);
+    string text = context.build_file();
+    fwrite(text.data(), 1, text.size(), out);
+    fflush(out);
+    phase[PHASE_WRITE] = now() - start;
+    result.reached = PHASE_WRITE+1;
+
+    for (unsigned p = 0; p < PHASE_COUNT; ++p)
+    {
+      if (r == 0 || phase[p] < result.seconds[p])
+        result.seconds[p] = phase[p];
+    }
+  }
+
+  fclose(in);
+  fclose(out);
+}
+
+/*!
+ * \brief Measure one program in a child process
+ *
+ * \return false if the child did not report back (the reason is in the note)
+ */
+
+static bool measure_isolated(const Shape *shape, unsigned long n, unsigned reps, Result &result)
+{
+  int fds[2];
+  memset(&result, 0, sizeof(result));
+  if (pipe(fds) != 0)
+  {
+    snprintf(result.note, sizeof(result.note), "pipe: %s", strerror(errno));
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    close(fds[0]);
+    Result child;
+    memset(&child, 0, sizeof(child));
+    measure(generate(shape, n), reps, child);
+    ssize_t w = write(fds[1], &child, sizeof(child));
+    _exit(w == sizeof(child) ? 0 : 1);
+  }
+  close(fds[1]);
+
+  ssize_t got = read(fds[0], &result, sizeof(result));
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  if (got == sizeof(result))
+    return true;
+  memset(&result, 0, sizeof(result));
+  if (WIFSIGNALED(status))
+    snprintf(result.note, sizeof(result.note), "compiler crashed (%s)", strsignal(WTERMSIG(status)));
+  else
+    snprintf(result.note, sizeof(result.note), "compiler exited with %d", WEXITSTATUS(status));
+  return false;
+}
+
+/*!
+ * \brief Fit time = c * N^k over the sizes that completed a phase
+ *
+ * \return k, or a negative number if there is not enough data to tell
+ */
+
+static double scaling(const vector<unsigned long> &sizes, const vector<Result> &results, unsigned p, double floor)
+{
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  unsigned count = 0;
+  for (unsigned i = 0; i < results.size(); ++i)
+  {
+    // Too small to say anything about
+    if (results[i].reached <= (int)p || results[i].seconds[p] < floor)
+      continue;
+    double x = log((double)sizes[i]);
+    double y = log(results[i].seconds[p]);
+    sx += x; sy += y; sxx += x*x; sxy += x*y;
+    ++count;
+  }
+  if (count < 2 || count*sxx - sx*sx == 0)
+    return -1;
+  return (count*sxy - sx*sy) / (count*sxx - sx*sx);
+}
+
+/*!
+ * Print usage statement
+ */
+
+void usage(const char *progname)
+{
+  cerr << "Usage: " << progname << " [-s shape] [-n N] [-k steps] [-r reps] [-t exponent] [-F]" << endl;
+  cerr << "  -s <shape>   Only run this shape (may be repeated; default: all)" << endl;
+  cerr << "  -n <N>       Starting size (default: per shape)" << endl;
+  cerr << "  -k <steps>   Number of times to double N (default: 4)" << endl;
+  cerr << "  -r <reps>    Keep the best of this many runs (default: 3)" << endl;
+  cerr << "  -t <k>       Flag phases that scale worse than N^k (default: 1.3)" << endl;
+  cerr << "  -F           Use the hand-written scanner instead of flex" << endl;
+  cerr << "Shapes:" << endl;
+  for (unsigned i = 0; shapes[i].name != NULL; ++i)
+    cerr << "  " << shapes[i].name << string(10 - string(shapes[i].name).size(), ' ')
+         << shapes[i].description << endl;
+  exit(1);
+}
+
+/*!
+ * Program execution entry point
+ *
+ * Exits with 2 if any phase was flagged as super-linear.
+ */
+
+int main(int argc, char **argv)
+{
+  static const char *options = "s:n:k:r:t:F";
+
+  vector<const Shape *> selected;
+  unsigned long base = 0;
+  unsigned steps = 4;
+  unsigned reps = 3;
+  double threshold = 1.3;
+  const double floor = 1e-3; // phases faster than this are mostly noise
+
+  // option parsing
+  while (true)
+  {
+    int c = getopt(argc, argv, options);
+    if (c == -1) break;
+    switch (c)
+    {
+      case 's':
+        if (shape_search(optarg) == NULL)
+        {
+          cerr << "Unknown shape: " << optarg << endl;
+          usage(*argv);
+        }
+        selected.push_back(shape_search(optarg));
+        break;
+      case 'n':
+        base = strtoul(optarg, NULL, 10);
+        break;
+      case 'k':
+        steps = strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        reps = std::max(1ul, strtoul(optarg, NULL, 10));
+        break;
+      case 't':
+        threshold = strtod(optarg, NULL);
+        break;
+      case 'F':
+        use_fastlex = 1;
+        break;
+      default:
+        usage(*argv);
+        break;
+    }
+  }
+  if (selected.empty())
+  {
+    for (unsigned i = 0; shapes[i].name != NULL; ++i)
+      selected.push_back(&shapes[i]);
+  }
+
+  vector<string> flagged;
+  cout << std::fixed;
+  for (unsigned s = 0; s < selected.size(); ++s)
+  {
+    const Shape *shape = selected[s];
+    vector<unsigned long> sizes;
+    vector<Result> results;
+
+    cout << shape->name << ": " << shape->description << endl;
+    cout << setw(10) << "N" << setw(12) << "bytes" << setw(10) << "tokens";
+    for (unsigned p = 0; p < PHASE_COUNT; ++p)
+      cout << setw(11) << (string(phase_names[p]) + " ms");
+    cout << setw(10) << "lex MB/s" << endl;
+
+    for (unsigned k = 0; k <= steps; ++k)
+    {
+      unsigned long n = (base ? base : shape->base) << k;
+      Result result;
+      measure_isolated(shape, n, reps, result);
+      sizes.push_back(n);
+      results.push_back(result);
+
+      cout << setw(10) << n << setw(12) << result.bytes << setw(10) << result.tokens;
+      for (unsigned p = 0; p < PHASE_COUNT; ++p)
+      {
+        if ((int)p < result.reached)
+          cout << setw(11) << setprecision(2) << result.seconds[p]*1e3;
+        else
+          cout << setw(11) << "-";
+      }
+      if (result.reached > PHASE_LEX && result.seconds[PHASE_LEX] > 0)
+        cout << setw(10) << setprecision(1) << result.bytes / result.seconds[PHASE_LEX] / 1e6;
+      if (result.note[0])
+        cout << "  (" << result.note << ")";
+      cout << endl;
+    }
+
+    cout << "  scaling:";
+    for (unsigned p = 0; p < PHASE_COUNT; ++p)
+    {
+      double exponent = scaling(sizes, results, p, floor);
+      cout << "  " << phase_names[p] << " ";
+      if (exponent < 0)
+      {
+        cout << "-";
+        continue;
+      }
+      cout << "N^" << setprecision(2) << exponent;
+      if (exponent > threshold)
+      {
+        cout << " (!)";
+        flagged.push_back(string(shape->name) + "/" + phase_names[p]);
+      }
+    }
+    cout << endl << endl;
+  }
+
+  if (flagged.empty())
+    return 0;
+  cout << "Super-linear phases (worse than N^" << setprecision(2) << threshold << "):" << endl;
+  for (unsigned i = 0; i < flagged.size(); ++i)
+    cout << "  " << flagged[i] << endl;
+  return 2;
+}
@@ -0,0 +1,276 @@
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#include <iomanip>
+using std::setw;
+using std::setprecision;
+
+#include <fstream>
+#include <sstream>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <getopt.h>
+
+#include "corpus.hpp"
+using namespace LOLBench;
+
+#include "ast.h"
+#include "fastlex.h"
+#include "grammar.tab.h"
+
+extern "C"
+{
+  void yyrestart(FILE *input_file);
+  extern unsigned long curline;
+}
+
+/*!
+ * \brief One token and its semantic value
+ */
+typedef struct {
+  int token;
+  int num;
+  unsigned long ulong;
+  string str;
+} Token;
+
+/*!
+ * \brief Get a monotonic time in seconds
+ */
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*!
+ * \brief Point one of the scanners at the start of a file
+ */
+
+static void rewind_input(FILE *f, bool fast)
+{
+  rewind(f);
+  if (fast)
+  {
+    fastlex_open(f);
+  }
+  else
+  {
+    yyrestart(f);
+    curline = 1;
+  }
+}
+
+/*!
+ * \brief Scan a whole file with one of the scanners, keeping every token
+ */
+
+static vector<Token> scan(FILE *f, bool fast)
+{
+  vector<Token> tokens;
+  int token;
+
+  rewind_input(f, fast);
+  while ((token = fast ? fastlex() : flex_lex()) != 0)
+  {
+    Token t;
+    t.token = token;
+    t.num = 0;
+    t.ulong = 0;
+    switch (token)
+    {
+      case T_NUMBER:
+        t.num = yylval.num;
+        break;
+      case T_WORD:
+      case T_STRING:
+        t.str = yylval.str;
+        free(yylval.str);
+        break;
+      default:
+        t.ulong = yylval.ulong;
+        break;
+    }
+    tokens.push_back(t);
+  }
+  return tokens;
+}
+
+/*!
+ * \brief Make sure both scanners produce the same tokens and values
+ *
+ * \return true if they agree
+ */
+
+static bool check(const string &name, FILE *f)
+{
+  vector<Token> want = scan(f, false);
+  vector<Token> got = scan(f, true);
+
+  for (unsigned i = 0; i < want.size() && i < got.size(); ++i)
+  {
+    const Token &w = want[i], &g = got[i];
+    if (w.token != g.token || w.num != g.num || w.ulong != g.ulong || w.str != g.str)
+    {
+      cerr << name << ": token " << i << " differs: flex gave " << w.token
+           << " (" << w.num << ", " << w.ulong << ", \"" << w.str << "\"), fastlex gave " << g.token
+           << " (" << g.num << ", " << g.ulong << ", \"" << g.str << "\")" << endl;
+      return false;
+    }
+  }
+  if (want.size() != got.size())
+  {
+    cerr << name << ": flex gave " << want.size() << " tokens, fastlex gave " << got.size() << endl;
+    return false;
+  }
+  return true;
+}
+
+/*!
+ * \brief Time one of the scanners over a whole file
+ *
+ * \return The best time in seconds
+ */
+
+static double measure(FILE *f, bool fast, unsigned reps, unsigned long &tokens)
+{
+  double best = 0;
+  for (unsigned r = 0; r < reps; ++r)
+  {
+    int token;
+    rewind_input(f, fast);
+    tokens = 0;
+    double start = now();
+    while ((token = fast ? fastlex() : flex_lex()) != 0)
+    {
+      if (token == T_WORD || token == T_STRING)
+        free(yylval.str);
+      ++tokens;
+    }
+    double seconds = now() - start;
+    if (r == 0 || seconds < best)
+      best = seconds;
+  }
+  return std::max(best, 1e-9);
+}
+
+/*!
+ * Print usage statement
+ */
+
+void usage(const char *progname)
+{
+  cerr << "Usage: " << progname << " [-n N] [-r reps] [file.lol ...]" << endl;
+  cerr << "  -n <N>       Size of the generated programs when no files are given (default: 64 * the shape's)" << endl;
+  cerr << "  -r <reps>    Keep the best of this many runs (default: 3)" << endl;
+  exit(1);
+}
+
+/*!
+ * Program execution entry point
+ *
+ * Exits with 1 if the scanners disagree on any input.
+ */
+
+int main(int argc, char **argv)
+{
+  static const char *options = "n:r:";
+
+  unsigned long n = 0;
+  unsigned reps = 3;
+
+  // option parsing
+  while (true)
+  {
+    int c = getopt(argc, argv, options);
+    if (c == -1) break;
+    switch (c)
+    {
+      case 'n':
+        n = strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        reps = std::max(1ul, strtoul(optarg, NULL, 10));
+        break;
+      default:
+        usage(*argv);
+        break;
+    }
+  }
+
+  // Either the files given or one program of each shape
+  vector<string> names, sources;
+  for (int i = optind; i < argc; ++i)
+  {
+    std::ifstream in(argv[i]);
+    if (!in)
+    {
+      cerr << "Unable to open " << argv[i] << endl;
+      return 1;
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    names.push_back(argv[i]);
+    sources.push_back(text.str());
+  }
+  if (names.empty())
+  {
+    for (unsigned i = 0; shapes[i].name != NULL; ++i)
+    {
+      names.push_back(shapes[i].name);
+      sources.push_back(generate(&shapes[i], n ? n : shapes[i].base * 64));
+    }
+  }
+
+  bool ok = true;
+  cout << std::fixed;
+  cout << setw(20) << std::left << "input" << std::right
+       << setw(10) << "bytes" << setw(10) << "tokens"
+       << setw(14) << "flex tok/s" << setw(14) << "fast tok/s"
+       << setw(11) << "flex MB/s" << setw(11) << "fast MB/s" << setw(9) << "speedup" << endl;
+  for (unsigned i = 0; i < names.size(); ++i)
+  {
+    FILE *f = tmpfile();
+    if (f == NULL)
+    {
+      perror("tmpfile");
+      return 1;
+    }
+    fwrite(sources[i].data(), 1, sources[i].size(), f);
+    fflush(f);
+
+    if (!check(names[i], f))
+    {
+      ok = false;
+      fclose(f);
+      continue;
+    }
+
+    unsigned long tokens = 0;
+    double flex = measure(f, false, reps, tokens);
+    double fast = measure(f, true, reps, tokens);
+    double mb = sources[i].size() / 1e6;
+
+    cout << setw(20) << std::left << names[i] << std::right
+         << setw(10) << sources[i].size() << setw(10) << tokens << setprecision(0)
+         << setw(14) << tokens / flex << setw(14) << tokens / fast << setprecision(1)
+         << setw(11) << mb / flex << setw(11) << mb / fast << setprecision(2)
+         << setw(8) << flex / fast << "x" << endl;
+    fclose(f);
+  }
+
+  return ok ? 0 : 1;
+}
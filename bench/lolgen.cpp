@@ -0,0 +1,46 @@
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#include <string>
+using std::string;
+
+#include <cstdlib>
+
+#include "corpus.hpp"
+using namespace LOLBench;
+
+/*!
+ * Print usage statement
+ */
+
+void usage(const char *progname)
+{
+  cerr << "Usage: " << progname << " <shape> <N>" << endl;
+  cerr << "Shapes:" << endl;
+  for (unsigned i = 0; shapes[i].name != NULL; ++i)
+    cerr << "  " << shapes[i].name << string(10 - string(shapes[i].name).size(), ' ')
+         << shapes[i].description << endl;
+  exit(1);
+}
+
+/*!
+ * Write a synthetic program to stdout
+ */
+
+int main(int argc, char **argv)
+{
+  if (argc != 3)
+    usage(*argv);
+
+  const Shape *shape = shape_search(argv[1]);
+  if (shape == NULL)
+  {
+    cerr << "Unknown shape: " << argv[1] << endl;
+    usage(*argv);
+  }
+
+  cout << generate(shape, strtoul(argv[2], NULL, 10));
+  return 0;
+}
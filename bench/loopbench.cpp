@@ -0,0 +1,284 @@
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#include <iomanip>
+using std::setw;
+using std::setprecision;
+
+#include <fstream>
+#include <sstream>
+
+#include <string>
+using std::string;
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "lolcode.hpp"
+using namespace LOLCode;
+
+#include "ast.h"
+#include "fastlex.h"
+
+extern "C"
+{
+  extern unsigned long curline;
+  extern unsigned long lineno;
+}
+
+/*!
+ * \brief An element-wise loop to time
+ */
+typedef struct {
+  const char *name;   /*!< The name used to select this kernel */
+  const char *body;   /*!< The statements run for each I */
+} Kernel;
+
+static const Kernel kernels[] = {
+  { "add",     "LOL MAH C!!I R UP MAH A!!I AN MAH B!!I" },
+  { "axpy",    "LOL MAH C!!I R UP TIEMZ MAH A!!I AN K AN MAH B!!I" },
+  { "update",  "UPZ MAH A!!I!!MAH B!!I\n    NERFZ MAH B!!I!!K" },
+  { "scale",   "LOL MAH C!!I R OVAR NERF TIEMZ MAH A!!I AN 3 AN MAH B!!I AN 4" },
+  { NULL, NULL }
+};
+
+/*!
+ * \brief Get a monotonic time in seconds
+ */
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*!
+ * \brief Write a program that runs a kernel over n elements reps times
+ *
+ * The arrays are filled in first and their sum is printed at the end, so the
+ * two builds can be checked against each other.
+ */
+
+static string program(const Kernel &kernel, unsigned long n, unsigned long reps)
+{
+  std::ostringstream out;
+  out << "HAI\n"
+      << "I HAS A A ITZ 0\nI HAS A B ITZ 0\nI HAS A C ITZ 0\n"
+      << "I HAS A K ITZ 3\nI HAS A N ITZ " << n << "\nI HAS A I ITZ 0\nI HAS A T ITZ 0\n"
+      << "IM IN YR FILL\n"
+      << "  LOL MAH A!!I R I\n  LOL MAH B!!I R NERF 1000 AN I\n  LOL MAH C!!I R 0\n"
+      << "  UPZ I!!\n  IZ NOT SMALR I AN N\n    GTFO\n  KTHX\nLOL\n"
+      << "IM IN YR REPS\n"
+      << "  LOL I R 0\n"
+      << "  IM IN YR KERNEL\n"
+      << "    " << kernel.body << "\n"
+      << "    UPZ I!!\n    IZ NOT SMALR I AN N\n      GTFO\n    KTHX\n  LOL\n"
+      << "  UPZ T!!\n  IZ NOT SMALR T AN " << reps << "\n    GTFO\n  KTHX\nLOL\n"
+      << "LOL T R 0\nLOL I R 0\n"
+      << "IM IN YR SUM\n"
+      << "  LOL T R UP T AN UP MAH A!!I AN UP MAH B!!I AN MAH C!!I\n"
+      << "  UPZ I!!\n  IZ NOT SMALR I AN N\n    GTFO\n  KTHX\nLOL\n"
+      << "VISIBLE T\n"
+      << "KTHXBYE\n";
+  return out.str();
+}
+
+/*!
+ * \brief Compile a program to assembly in-process
+ *
+ * \return false (after saying why) if it did not compile
+ */
+
+static bool compile(const string &source, bool vectorize, const string &output)
+{
+  FILE *in = tmpfile();
+  if (in == NULL)
+  {
+    perror("tmpfile");
+    return false;
+  }
+  fwrite(source.data(), 1, source.size(), in);
+  fflush(in);
+  rewind(in);
+  use_fastlex = 1;
+  fastlex_open(in);
+  curline = 1;
+  lineno = 0;
+  ASTNode *root = generate_ast();
+  fclose(in);
+  if (root == NULL)
+  {
+    cerr << "No valid A.S.T. generated" << endl;
+    return false;
+  }
+
+  CompilerContext context;
+  context.flags["no_vectorize"] = !vectorize;
+  try
+  {
+    run_hook(root, context);
+  }
+  catch (HookError e)
+  {
+    cerr << "Error in compiling: " << e.to_string() << endl;
+    return false;
+  }
+  std::ofstream out(output.c_str());
+  out << context.build_file();
+  return out.good();
+}
+
+/*!
+ * \brief Run a program, keeping the best time and its output
+ *
+ * \return The best time in seconds, or a negative number if it failed
+ */
+
+static double run(const string &binary, unsigned reps, string &output)
+{
+  double best = -1;
+  for (unsigned r = 0; r < reps; ++r)
+  {
+    double start = now();
+    FILE *p = popen(binary.c_str(), "r");
+    if (p == NULL)
+      return -1;
+    char buf[256];
+    size_t got;
+    output.clear();
+    while ((got = fread(buf, 1, sizeof(buf), p)) > 0)
+      output.append(buf, got);
+    if (pclose(p) != 0)
+      return -1;
+    double seconds = now() - start;
+    if (best < 0 || seconds < best)
+      best = seconds;
+  }
+  return best;
+}
+
+/*!
+ * Print usage statement
+ */
+
+void usage(const char *progname)
+{
+  cerr << "Usage: " << progname << " [-k kernel] [-n N] [-i iterations] [-r reps] [-l command] [-d dir]" << endl;
+  cerr << "  -k <kernel>  Only run this kernel (default: all)" << endl;
+  cerr << "  -n <N>       Number of elements in each BUKKIT (default: 4096)" << endl;
+  cerr << "  -i <count>   Times each program runs the kernel (default: 2000)" << endl;
+  cerr << "  -r <reps>    Keep the best of this many runs (default: 3)" << endl;
+  cerr << "  -l <command> Command to link with; \"<file>.s -o <file>\" is appended" << endl;
+  cerr << "               (default: gcc -m32 -O2 -DASMUTIL_NOTRACE asmutil.c)" << endl;
+  cerr << "  -d <dir>     Where to put the programs (default: /tmp)" << endl;
+  cerr << "Kernels:" << endl;
+  for (unsigned i = 0; kernels[i].name != NULL; ++i)
+    cerr << "  " << kernels[i].name << string(10 - string(kernels[i].name).size(), ' ')
+         << kernels[i].body << endl;
+  exit(1);
+}
+
+/*!
+ * Program execution entry point
+ *
+ * Exits with 1 if a program failed to build or run, or if the two builds of
+ * a kernel disagree.
+ */
+
+int main(int argc, char **argv)
+{
+  static const char *options = "k:n:i:r:l:d:";
+
+  const char *only = NULL;
+  unsigned long n = 4096;
+  unsigned long iterations = 2000;
+  unsigned reps = 3;
+  string link = "gcc -m32 -O2 -DASMUTIL_NOTRACE asmutil.c";
+  string dir = "/tmp";
+
+  // option parsing
+  while (true)
+  {
+    int c = getopt(argc, argv, options);
+    if (c == -1) break;
+    switch (c)
+    {
+      case 'k':
+        only = optarg;
+        break;
+      case 'n':
+        n = std::max(1ul, strtoul(optarg, NULL, 10));
+        break;
+      case 'i':
+        iterations = std::max(1ul, strtoul(optarg, NULL, 10));
+        break;
+      case 'r':
+        reps = std::max(1ul, strtoul(optarg, NULL, 10));
+        break;
+      case 'l':
+        link = optarg;
+        break;
+      case 'd':
+        dir = optarg;
+        break;
+      default:
+        usage(*argv);
+        break;
+    }
+  }
+
+  bool ok = true;
+  cout << std::fixed;
+  cout << setw(10) << std::left << "kernel" << std::right
+       << setw(12) << "scalar ms" << setw(12) << "sse2 ms"
+       << setw(14) << "scalar ns/el" << setw(12) << "sse2 ns/el" << setw(9) << "speedup" << endl;
+  for (unsigned k = 0; kernels[k].name != NULL; ++k)
+  {
+    if (only != NULL && strcmp(only, kernels[k].name) != 0)
+      continue;
+    string source = program(kernels[k], n, iterations);
+    double seconds[2];
+    string outputs[2];
+    bool built = true;
+    for (int v = 0; v < 2 && built; ++v)
+    {
+      string base = dir + "/loopbench-" + std::to_string(getpid()) + "-" + kernels[k].name + (v ? "-sse2" : "-scalar");
+      if (!compile(source, v == 1, base + ".s") ||
+          system((link + " " + base + ".s -o " + base).c_str()) != 0 ||
+          (seconds[v] = run(base, reps, outputs[v])) < 0)
+      {
+        cerr << kernels[k].name << ": could not build or run " << base << endl;
+        built = false;
+      }
+      unlink((base + ".s").c_str());
+      unlink(base.c_str());
+    }
+    if (!built)
+    {
+      ok = false;
+      continue;
+    }
+    if (outputs[0] != outputs[1])
+    {
+      cerr << kernels[k].name << ": the scalar build printed " << outputs[0]
+           << " but the SSE2 build printed " << outputs[1] << endl;
+      ok = false;
+      continue;
+    }
+
+    double elements = (double)n * iterations;
+    cout << setw(10) << std::left << kernels[k].name << std::right << setprecision(1)
+         << setw(12) << seconds[0] * 1e3 << setw(12) << seconds[1] * 1e3 << setprecision(2)
+         << setw(14) << seconds[0] / elements * 1e9 << setw(12) << seconds[1] / elements * 1e9
+         << setw(8) << seconds[0] / seconds[1] << "x" << endl;
+  }
+
+  return ok ? 0 : 1;
+}
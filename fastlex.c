@@ -0,0 +1,544 @@
+/*! \file Hand-written, vectorized scanner (see fastlex.h) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "grammar.tab.h"
+#include "fastlex.h"
+
+int use_fastlex = 0;
+
+/*
+ * The whole input (or the chunk of a stream being scanned) is read into one
+ * buffer followed by PAD zero bytes, so the vector loads below never have to
+ * worry about running off the end.
+ */
+#define PAD 32
+
+static char *input = NULL;
+static const char *pos = NULL;
+static const char *end = NULL;
+static int opened = 0;
+
+/*
+ * fastlex_open_stream: the rest of the input, which is read a chunk of whole
+ * lines at a time (a token never runs past the end of its line)
+ */
+#define STREAM_CHUNK 65536
+static FILE *stream = NULL;
+static char *partial = NULL;     /* the start of a line read past the last newline */
+static unsigned long partial_len = 0;
+
+static unsigned long line = 1;   /* same as curline in lexer.l */
+static int pending_newline = 0;  /* LOLOL... was split into LOL and a newline */
+
+/*
+ * Keep the same error reporting as lexer.l, but instead of exiting hand the
+ * parser bison's error token: it gives up on the input (without a second
+ * message) and the caller sees the failed parse, so the compile server can
+ * answer with the error and go on to its next client.
+ */
+static int str_err(const char *err)
+{
+  fprintf(stderr, "error in lex (line %d col %d): %s\n", -1 /*yyline*/, -1/*yycolumn*/, err);
+  return YYerror;
+}
+
+/*
+ * Character classification, one vector at a time.  Each *_stop function
+ * returns a bit mask of the bytes at p (bit 0 is p[0]) that end the scan.
+ */
+
+#if defined(__AVX2__)
+
+#define VEC 32
+typedef __m256i vec_t;
+#define LOAD(p)       _mm256_loadu_si256((const __m256i*)(p))
+#define SET1(c)       _mm256_set1_epi8(c)
+#define EQ(a,b)       _mm256_cmpeq_epi8(a,b)
+#define GT(a,b)       _mm256_cmpgt_epi8(a,b)
+#define OR(a,b)       _mm256_or_si256(a,b)
+#define AND(a,b)      _mm256_and_si256(a,b)
+#define MASK(v)       ((unsigned)_mm256_movemask_epi8(v))
+#define ALL           0xFFFFFFFFu
+
+#elif defined(__SSE2__)
+
+#define VEC 16
+typedef __m128i vec_t;
+#define LOAD(p)       _mm_loadu_si128((const __m128i*)(p))
+#define SET1(c)       _mm_set1_epi8(c)
+#define EQ(a,b)       _mm_cmpeq_epi8(a,b)
+#define GT(a,b)       _mm_cmpgt_epi8(a,b)
+#define OR(a,b)       _mm_or_si128(a,b)
+#define AND(a,b)      _mm_and_si128(a,b)
+#define MASK(v)       ((unsigned)_mm_movemask_epi8(v))
+#define ALL           0xFFFFu
+
+#endif
+
+static int is_ident(unsigned char c)
+{
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+#ifdef VEC
+
+/* [lo,hi] for bytes below 0x80 (the signed compare treats the rest as negative) */
+static vec_t in_range(vec_t v, char lo, char hi)
+{
+  return AND(GT(v, SET1(lo-1)), GT(SET1(hi+1), v));
+}
+
+/* not [A-Za-z0-9_] */
+static unsigned ident_stop(const char *p)
+{
+  vec_t v = LOAD(p);
+  vec_t ident = OR(OR(in_range(v, 'A', 'Z'), in_range(v, 'a', 'z')),
+                   OR(in_range(v, '0', '9'), EQ(v, SET1('_'))));
+  return ~MASK(ident) & ALL;
+}
+
+/* not [\t ] */
+static unsigned blank_stop(const char *p)
+{
+  vec_t v = LOAD(p);
+  return ~MASK(OR(EQ(v, SET1(' ')), EQ(v, SET1('\t')))) & ALL;
+}
+
+/* \n */
+static unsigned newline_stop(const char *p)
+{
+  return MASK(EQ(LOAD(p), SET1('\n')));
+}
+
+/* one of \" \\ \n */
+static unsigned string_stop(const char *p)
+{
+  vec_t v = LOAD(p);
+  return MASK(OR(OR(EQ(v, SET1('"')), EQ(v, SET1('\\'))), EQ(v, SET1('\n'))));
+}
+
+#else
+
+#define VEC 1
+
+static unsigned ident_stop(const char *p)   { return !is_ident(*p); }
+static unsigned blank_stop(const char *p)   { return *p != ' ' && *p != '\t'; }
+static unsigned newline_stop(const char *p) { return *p == '\n'; }
+static unsigned string_stop(const char *p)  { return *p == '"' || *p == '\\' || *p == '\n'; }
+
+#endif
+
+/*
+ * Find the first byte in [p,end) that stops the scan (or end if none do)
+ */
+#define SCANNER(name, stop) \
+  static const char *name(const char *p) \
+  { \
+    for (; p < end; p += VEC) \
+    { \
+      unsigned m = stop(p); \
+      if (m) \
+      { \
+        p += __builtin_ctz(m); \
+        return (p < end) ? p : end; \
+      } \
+    } \
+    return end; \
+  }
+
+SCANNER(skip_ident, ident_stop)
+SCANNER(skip_blank, blank_stop)
+SCANNER(find_newline, newline_stop)
+SCANNER(find_string_stop, string_stop)
+
+/*
+ * Single word keywords, by perfect hash.  The hash (see keyword()) has no
+ * collisions among these; a word is a keyword only if all of it matches.
+ */
+typedef struct {
+  const char *word;
+  unsigned char len;
+  int token;
+} keyword_t;
+
+static const keyword_t keywords[128] = {
+  [  5] = { "DIAF", 4, DIAF },
+  [  8] = { "LETTAR", 6, LETTAR },
+  [ 10] = { "AND", 3, AND },
+  [ 12] = { "LOL", 3, LOL },
+  [ 14] = { "NERF", 4, MINUS },
+  [ 17] = { "TIEMZD", 6, MULTEQ },
+  [ 22] = { "TIEMZ", 5, MULT },
+  [ 23] = { "UP", 2, PLUS },
+  [ 29] = { "OUTTA", 5, OUTTA },
+  [ 40] = { "DEN", 3, ARGSEP },
+  [ 42] = { "STDIN", 5, STDIN },
+  [ 43] = { "AN", 2, ARGSEP },
+  [ 45] = { "FAIL", 4, FAIL },
+  [ 49] = { "NOWAI", 5, NOWAI },
+  [ 51] = { "LINE", 4, LINE },
+  [ 56] = { "BYES", 4, BYES },
+  [ 57] = { "BIGR", 4, GREATER },
+  [ 58] = { "UPZ", 3, PLUSEQ },
+  [ 65] = { "YARLY", 5, YARLY },
+  [ 67] = { "IZ", 2, IZ },
+  [ 70] = { "XOR", 3, XOR },
+  [ 71] = { "MAH", 3, ARR },
+  [ 75] = { "KTHXBYE", 7, KTHXBYE },
+  [ 83] = { "NERFZ", 5, MINUSEQ },
+  [ 85] = { "OVARZ", 5, DIVEQ },
+  [ 88] = { "GTFO", 4, GTFO },
+  [ 90] = { "LIEK", 4, EQUALTO },
+  [ 93] = { "WORD", 4, WORD },
+  [ 95] = { "HAI", 3, HAI },
+  [105] = { "OR", 2, OR },
+  [106] = { "ITZ", 3, ITZ },
+  [107] = { "R", 1, R },
+  [108] = { "OVAR", 4, DIV },
+  [113] = { "SMALR", 5, LESS },
+  [117] = { "VISIBLE", 7, PRINT },
+  [118] = { "NOT", 3, NOT },
+  [119] = { "WIN", 3, WIN },
+  [120] = { "GIMMEH", 6, GIMMEH },
+  [127] = { "KTHX", 4, KTHX },
+};
+
+/*
+ * \return The token for the word at p, or 0 if it's not a keyword
+ */
+static int keyword(const char *p, unsigned long len)
+{
+  const unsigned char *w = (const unsigned char *)p;
+  const keyword_t *k;
+  if (len > 7)
+    return 0;
+  k = &keywords[(w[0] + w[len-1]*29 + w[len/2]*15 + len) & 127];
+  if (k->len == len && memcmp(k->word, p, len) == 0)
+    return k->token;
+  return 0;
+}
+
+static int starts_with(const char *p, const char *literal)
+{
+  size_t len = strlen(literal);
+  return (size_t)(end - p) >= len && memcmp(p, literal, len) == 0;
+}
+
+/*
+ * LOL(OL)+ closes several loops at once
+ */
+static int is_lolol(const char *p, unsigned long len)
+{
+  unsigned long i;
+  if (len < 5 || len % 2 == 0 || p[0] != 'L')
+    return 0;
+  for (i = 1; i < len; i += 2)
+  {
+    if (p[i] != 'O' || p[i+1] != 'L')
+      return 0;
+  }
+  return 1;
+}
+
+/*
+ * Scan a word starting at pos.  flex takes the longest match (the first rule
+ * on a tie), so multi-word keywords beat the word they start with, a comment
+ * beats everything on its line and a keyword only matches a whole word.
+ */
+static int scan_word(void)
+{
+  const char *start = pos;
+  const char *stop;
+  unsigned long len;
+  int token;
+
+  yylval.ulong = line;
+  if (start[0] == 'B' && starts_with(start, "BTW"))
+  {
+    // BTW.*$ needs the newline to be there (but doesn't eat it)
+    stop = find_newline(start+3);
+    if (stop < end)
+    {
+      pos = stop;
+      return COMMENT;
+    }
+  }
+  if (start[0] == 'C' && starts_with(start, "CAN HAS"))
+  {
+    pos += 7;
+    return INCLUDE;
+  }
+  if (start[0] == 'I' && starts_with(start, "I HAS A"))
+  {
+    pos += 7;
+    return DECLARE;
+  }
+  if (start[0] == 'I' && starts_with(start, "IM IN YR"))
+  {
+    pos += 8;
+    return INFLOOP;
+  }
+
+  stop = skip_ident(start);
+  len = stop - start;
+  pos = stop;
+
+  for (token = 0; start + token < stop && start[token] >= '0' && start[token] <= '9'; ++token)
+    ;
+  if (start + token == stop)
+  {
+    yylval.num = atoi(start);
+    return T_NUMBER;
+  }
+
+  token = keyword(start, len);
+  if (token)
+    return token;
+
+  if (is_lolol(start, len))
+  {
+    // Same as yyless(2); unput('\n') in lexer.l
+    pos = start + 2;
+    pending_newline = 1;
+    return LOL;
+  }
+
+  yylval.str = strndup(start, len);
+  return T_WORD;
+}
+
+/*
+ * Append to the string being built by scan_string()
+ */
+static char *str_buf = NULL;
+static unsigned long str_len = 0;
+static unsigned long str_cap = 0;
+
+static void str_app(const char *s, unsigned long len)
+{
+  if (str_len + len + 1 > str_cap)
+  {
+    while (str_len + len + 1 > str_cap)
+      str_cap = str_cap ? str_cap * 2 : 64;
+    str_buf = (char*)realloc(str_buf, str_cap);
+  }
+  memcpy(str_buf + str_len, s, len);
+  str_len += len;
+}
+
+/*
+ * Scan a string constant; pos is just past the opening quote
+ */
+static int scan_string(void)
+{
+  const char *stop;
+  char c;
+  int oct, dec, value;
+
+  str_len = 0;
+  for (;;)
+  {
+    stop = find_string_stop(pos);
+    str_app(pos, stop - pos);
+    pos = stop;
+    if (pos >= end)
+      return 0;
+
+    switch (*pos)
+    {
+      case '"':
+        ++pos;
+        str_app("", 1);
+        yylval.str = (char*)malloc(str_len);
+        memcpy(yylval.str, str_buf, str_len);
+        return T_STRING;
+      case '\n':
+        ++line;
+        return str_err("Unterminated string constant - \\ needed?");
+    }
+
+    // A backslash
+    if (pos + 1 >= end)
+    {
+      // Nothing in the string rules matches it, so flex echoes it
+      putchar('\\');
+      ++pos;
+      continue;
+    }
+    c = pos[1];
+    if (c >= '0' && c <= '9')
+    {
+      for (oct = 0; oct < 3 && pos[1+oct] >= '0' && pos[1+oct] <= '7'; ++oct)
+        ;
+      for (dec = oct; pos[1+dec] >= '0' && pos[1+dec] <= '9'; ++dec)
+        ;
+      if (dec > oct)
+        return str_err("Bad escape sequence");
+      for (value = 0, dec = 0; dec < oct; ++dec)
+        value = value * 8 + (pos[1+dec] - '0');
+      // lexer.l only keeps the out-of-range values (sic)
+      if (value > 0xff)
+      {
+        c = (char)value;
+        str_app(&c, 1);
+      }
+      pos += 1 + oct;
+      continue;
+    }
+    switch (c)
+    {
+      case 'n': c = '\n'; break;
+      case 't': c = '\t'; break;
+      case 'r': c = '\r'; break;
+      case 'b': c = '\b'; break;
+      case 'f': c = '\f'; break;
+    }
+    str_app(&c, 1);
+    pos += 2;
+  }
+}
+
+/*
+ * Replace the buffer with the next chunk of the stream, ending at a newline
+ * (or the end of the input)
+ *
+ * Returns 0 at the end of the input.
+ */
+static int refill(void)
+{
+  char *data = partial;
+  unsigned long size = partial_len, cap = partial_len, cut;
+  size_t got;
+
+  if (stream == NULL)
+    return 0;
+  for (;;)
+  {
+    if (cap - size < STREAM_CHUNK)
+    {
+      cap = size + STREAM_CHUNK;
+      data = (char*)realloc(data, cap);
+    }
+    got = fread(data + size, 1, cap - size, stream);
+    if (got == 0)
+    {
+      stream = NULL;
+      cut = size;
+      break;
+    }
+    size += got;
+    for (cut = size; cut > size - got && data[cut-1] != '\n'; --cut)
+      ;
+    if (cut > size - got)
+      break;
+  }
+
+  input = (char*)realloc(input, cut + PAD);
+  memcpy(input, data, cut);
+  memset(input + cut, 0, PAD);
+  pos = input;
+  end = input + cut;
+  partial_len = size - cut;
+  memmove(data, data + cut, partial_len);
+  partial = data;
+  return cut > 0;
+}
+
+int fastlex(void)
+{
+  if (!opened)
+    fastlex_open(stdin);
+
+  if (pending_newline)
+  {
+    pending_newline = 0;
+    yylval.ulong = line;
+    return NEWLINE;
+  }
+
+  while (pos < end || refill())
+  {
+    switch (*pos)
+    {
+      case ' ':
+      case '\t':
+        pos = skip_blank(pos);
+        break;
+      case '\n':
+        ++pos;
+        yylval.ulong = ++line;
+        return NEWLINE;
+      case '.':
+        ++pos;
+        yylval.ulong = line;
+        return NEWLINE;
+      case '?':
+        ++pos;
+        yylval.ulong = line;
+        return P_QMARK;
+      case '!':
+        ++pos;
+        yylval.ulong = line;
+        return P_EXCL;
+      case '"':
+        ++pos;
+        return scan_string();
+      default:
+        if (is_ident(*pos))
+          return scan_word();
+        // Same as flex's default rule
+        putchar(*pos++);
+        break;
+    }
+  }
+  return 0;
+}
+
+void fastlex_open_buffer(const char *data, unsigned long size)
+{
+  free(input);
+  input = (char*)malloc(size + PAD);
+  memcpy(input, data, size);
+  memset(input + size, 0, PAD);
+  pos = input;
+  end = input + size;
+  line = 1;
+  pending_newline = 0;
+  opened = 1;
+  stream = NULL;
+}
+
+void fastlex_open(FILE *in)
+{
+  char *data = NULL;
+  unsigned long size = 0, cap = 0;
+  size_t got;
+
+  do
+  {
+    if (size == cap)
+    {
+      cap = cap ? cap * 2 : 65536;
+      data = (char*)realloc(data, cap);
+    }
+    got = fread(data + size, 1, cap - size, in);
+    size += got;
+  } while (got > 0);
+
+  fastlex_open_buffer(data, size);
+  free(data);
+}
+
+void fastlex_open_stream(FILE *in)
+{
+  fastlex_open_buffer("", 0);
+  stream = in;
+  partial_len = 0;
+}
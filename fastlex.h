@@ -0,0 +1,54 @@
+#ifndef FASTLEX_H
+#define FASTLEX_H
+
+#include <stdio.h>
+
+/*!
+ * \brief Hand-written scanner
+ *
+ *   A drop-in alternative to the flex scanner in lexer.l.  It produces the
+ * same token stream (including the same semantic values and the same quirks)
+ * but classifies characters 16 (SSE2) or 32 (AVX2) bytes at a time and finds
+ * keywords with a perfect hash instead of running the flex automaton.
+ *
+ *   yylex() (in grammar.y) calls this instead of the flex scanner when
+ * use_fastlex is set.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Set this to make yylex() use fastlex() instead of the flex scanner */
+extern int use_fastlex;
+
+/*!
+ * \brief The flex scanner (lexer.l)
+ */
+int flex_lex(void);
+
+/*!
+ * \brief Return the next token (0 at the end of the input)
+ */
+int fastlex(void);
+
+/*!
+ * \brief Read all of a file to be scanned (stdin is used if this is never called)
+ */
+void fastlex_open(FILE *in);
+
+/*!
+ * \brief Read a file to be scanned as it goes, a chunk of whole lines at a time
+ */
+void fastlex_open_stream(FILE *in);
+
+/*!
+ * \brief Scan a copy of a buffer
+ */
+void fastlex_open_buffer(const char *data, unsigned long size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,6 +5,8 @@
 
 // abstract syntax tree
 #include "ast.h"
+// scanners
+#include "fastlex.h"
 
 int yylex();
 void yyerror(const char *str);
@@ -19,24 +21,22 @@ int yywrap();
 // Globals that we need ( :( )
 ast_node *root = NULL;
 unsigned long lineno = 0;
+unsigned long program_lineno = 0; // where HAI is
 
-// Duplicate an integer for inclusion in the parse tree
-void *idup(int x)
-{
-  int *r = (int *)malloc(sizeof(int));
-  *r = x;
-  return r;
-}
+// The program's own statement list (the first one started)
+static ast_node *top_stmts = NULL;
 
-// Duplicate a char for inclusion in the parse tree
-void *cdup(char x)
-{
-  char *r = (char *)malloc(sizeof(char));
-  *r = x;
-  return r;
-}
+// Streaming: the top-level statements that are parsed but not yet handed out
+static yypstate *stream_ps = NULL;
+static ast_node **stream_ready = NULL;
+static unsigned stream_head = 0, stream_count = 0, stream_cap = 0;
+static int stream_status = 0;
+
+static void stream_stmt(ast_node *stmt);
 %}
 
+%define api.push-pull both
+
 
 %union {
   int   num;
@@ -72,7 +72,7 @@ void *cdup(char x)
 %type <node> self_assignment stmt stmts
 %type <ulong> prog_start prog_end
 
-%expect 90
+%expect 2
 
 %start program
 
@@ -102,6 +102,7 @@ array_index : T_NUMBER ARR { $$ = CT(TN,LN); AL($$,idup($1)); }
 */
 
 assignment : array R expr     { $$ = CN(TN,LN); ALL($$,$1,$3); }
+           | LOL array R expr { $$ = CN(TN,LN); ALL($$,$2,$4); }
 ;
 
 brk : GTFO { $$ = CT(TN,LN); }
@@ -110,15 +111,15 @@ brk : GTFO { $$ = CT(TN,LN); }
 comment : COMMENT { $$ = CT(TN,LN); }
 ;
 
-condexpr : WIN                      { int b = 1; $$ = CT(TN,LN); AL($$,idup(b)); }
-         | FAIL                     { int b = 0; $$ = CT(TN,LN); AL($$,idup(b)); }
-         | GREATER expr argsep expr        { $$ = CN(TN,LN); ALLL($$,cdup('>'),$2,$4); }
-         | LESS expr argsep expr           { $$ = CN(TN,LN); ALLL($$,cdup('<'),$2,$4); }
-         | EQUALTO expr argsep expr        { $$ = CN(TN,LN); ALLL($$,cdup('='),$2,$4); }
-         | OR condexpr argsep condexpr     { $$ = CN(TN,LN); ALLL($$,cdup('|'),$2,$4); }
-         | AND condexpr argsep condexpr    { $$ = CN(TN,LN); ALLL($$,cdup('&'),$2,$4); }
-         | XOR condexpr argsep condexpr    { $$ = CN(TN,LN); ALLL($$,cdup('^'),$2,$4); }
-         | NOT condexpr                    { $$ = CN(TN,LN); ALL($$,cdup('!'),$2); }
+condexpr : WIN                      { int b = 1; $$ = CT(TN,LN); ALI($$,b); }
+         | FAIL                     { int b = 0; $$ = CT(TN,LN); ALI($$,b); }
+         | GREATER expr argsep expr        { $$ = CN(TN,LN); ALC($$,'>'); ALL($$,$2,$4); }
+         | LESS expr argsep expr           { $$ = CN(TN,LN); ALC($$,'<'); ALL($$,$2,$4); }
+         | EQUALTO expr argsep expr        { $$ = CN(TN,LN); ALC($$,'='); ALL($$,$2,$4); }
+         | OR condexpr argsep condexpr     { $$ = CN(TN,LN); ALC($$,'|'); ALL($$,$2,$4); }
+         | AND condexpr argsep condexpr    { $$ = CN(TN,LN); ALC($$,'&'); ALL($$,$2,$4); }
+         | XOR condexpr argsep condexpr    { $$ = CN(TN,LN); ALC($$,'^'); ALL($$,$2,$4); }
+         | NOT condexpr                    { $$ = CN(TN,LN); ALC($$,'!'); AL($$,$2); }
 ;
 
 conditional : IZ condexpr then stmts KTHX     { $$ = CN(TN,$1); ALL($$,$2,$4); }
@@ -134,8 +135,8 @@ elsethen : NOWAI end_stmt
 end_stmt : NEWLINE           { lineno = $1; }
 ;
 
-exit : DIAF exit_status exit_message     { $$ = CN(TN,LN); ALL($$,$2,$3); }
-     | BYES exit_status exit_message     { $$ = CN(TN,LN); ALL($$,$2,$3); }
+exit : DIAF exit_status exit_message     { $$ = CN(TN,LN); ALC($$,'D'); ALL($$,$2,$3); }
+     | BYES exit_status exit_message     { $$ = CN(TN,LN); ALC($$,'B'); ALL($$,$2,$3); }
 ;
 
 exit_status : /* nothing */ { $$ = CT(TN,LN); }
@@ -169,10 +170,10 @@ index_expr : word                          { $$ = CN(TN,LN); AL($$,$1); }
 expr : string            { $$ = $1; }
      | number            { $$ = $1; }
      | array             { $$ = $1; }
-     | PLUS expr argsep expr    { $$ = CN(TN,LN); ALLL($$,cdup('+'),$2,$4); }
-     | MINUS expr argsep expr   { $$ = CN(TN,LN); ALLL($$,cdup('-'),$2,$4); }
-     | MULT expr argsep expr    { $$ = CN(TN,LN); ALLL($$,cdup('*'),$2,$4); }
-     | DIV expr argsep expr     { $$ = CN(TN,LN); ALLL($$,cdup('/'),$2,$4); }
+     | PLUS expr argsep expr    { $$ = CN(TN,LN); ALC($$,'+'); ALL($$,$2,$4); }
+     | MINUS expr argsep expr   { $$ = CN(TN,LN); ALC($$,'-'); ALL($$,$2,$4); }
+     | MULT expr argsep expr    { $$ = CN(TN,LN); ALC($$,'*'); ALL($$,$2,$4); }
+     | DIV expr argsep expr     { $$ = CN(TN,LN); ALC($$,'/'); ALL($$,$2,$4); }
 ;
 
 include : INCLUDE word P_QMARK   { $$ = CN(TN,LN); AL($$,$2); }
@@ -187,9 +188,9 @@ initializer: ITZ expr     { $$ = CN(TN,LN); AL($$,$2); }
 ;
 
 input_type : /* empty */      { $$ = CT(TN,LN); }
-           | WORD     { $$ = CT(TN,LN); }
-           | LINE     { $$ = CT(TN,LN); }
-           | LETTAR     { $$ = CT(TN,LN); }
+           | WORD     { $$ = CT(TN,LN); ALC($$,'W'); }
+           | LINE     { $$ = CT(TN,LN); ALC($$,'L'); }
+           | LETTAR     { $$ = CT(TN,LN); ALC($$,'C'); }
 ;
 
 input_from : /* empty */     { $$ = CT(TN,LN); }
@@ -203,23 +204,23 @@ input : GIMMEH input_type array input_from { $$ = CN(TN,LN); ALLL($$,$2,$3,$4);
 loop : INFLOOP word end_stmt stmts LOL     { $$ = CN(TN,$1); ALL($$,$2,$4); }
 ;
 
-number : T_NUMBER         { $$ = CT(TN,LN); AL($$,idup($1)); }
+number : T_NUMBER         { $$ = CT(TN,LN); ALI($$,$1); }
 
 output : PRINT expr     { $$ = CT(TN,LN); AL($$,$2); }
-       | PRINT expr P_EXCL     { $$ = CT(TN,LN); ALL($$,$2,cdup('!')); }
+       | PRINT expr P_EXCL     { $$ = CT(TN,LN); AL($$,$2); ALC($$,'!'); }
 ;
 
-prog_start : HAI end_stmt { $$ = $1 }
+prog_start : HAI end_stmt { $$ = $1; program_lineno = $1; }
 ;
 
-prog_end   : KTHXBYE { $$ = $1 }
-           | prog_end end_stmt { $$ = $1 }
+prog_end   : KTHXBYE { $$ = $1; }
+           | prog_end end_stmt { $$ = $1; }
 ;
 
-self_assignment : PLUSEQ array P_EXCL P_EXCL increment_expr    { $$ = CN(TN,LN); ALLL($$,cdup('+'),$2,$5); }
-                | MINUSEQ array P_EXCL P_EXCL increment_expr   { $$ = CN(TN,LN); ALLL($$,cdup('-'),$2,$5); }
-                | MULTEQ array P_EXCL P_EXCL increment_expr    { $$ = CN(TN,LN); ALLL($$,cdup('*'),$2,$5); }
-                | DIVEQ array P_EXCL P_EXCL increment_expr     { $$ = CN(TN,LN); ALLL($$,cdup('/'),$2,$5); }
+self_assignment : PLUSEQ array P_EXCL P_EXCL increment_expr    { $$ = CN(TN,LN); ALC($$,'+'); ALL($$,$2,$5); }
+                | MINUSEQ array P_EXCL P_EXCL increment_expr   { $$ = CN(TN,LN); ALC($$,'-'); ALL($$,$2,$5); }
+                | MULTEQ array P_EXCL P_EXCL increment_expr    { $$ = CN(TN,LN); ALC($$,'*'); ALL($$,$2,$5); }
+                | DIVEQ array P_EXCL P_EXCL increment_expr     { $$ = CN(TN,LN); ALC($$,'/'); ALL($$,$2,$5); }
 ;
 
 stmt : include               { $$ = $1; }
@@ -236,13 +237,13 @@ stmt : include               { $$ = $1; }
      | comment               { $$ = $1; }
 ;
 
-stmts : /* No statements at all */     { $$ = CT(TN,LN); }
-      | stmts end_stmt /* empty line */     { $$ = CN(TN,LN); AL($$,$1); }
-      | stmt end_stmt            { $$ = CN(TN,LN); AL($$,$1); }
-      | stmts stmt end_stmt      { $$ = CN(TN,LN); ALL($$,$1,$2); }
+/* One node per list: statements are appended to it as they are parsed */
+stmts : /* No statements at all */     { $$ = CN(TN,LN); if (!top_stmts) top_stmts = $$; }
+      | stmts end_stmt /* empty line */     { $$ = $1; }
+      | stmts stmt end_stmt      { $$ = $1; if ($1 == top_stmts && stream_ps) stream_stmt($2); else AL($$,$2); }
 ;
 
-string : T_STRING { $$ = CT(TN,LN); AL($$,$1); }
+string : T_STRING { $$ = CT(TN,LN); ALT($$,$1); }
 
 then : end_stmt
      | P_QMARK end_stmt
@@ -250,7 +251,7 @@ then : end_stmt
      | P_QMARK end_stmt YARLY
 ;
 
-word : T_WORD    { $$ = CT(TN,LN); AL($$,$1); }
+word : T_WORD    { $$ = CT(TN,LN); ALT($$,$1); }
 
 %%
 void yyerror(const char *str)
@@ -263,14 +264,88 @@ int yywrap()
   return 1;
 }
 
+int yylex()
+{
+  return use_fastlex ? fastlex() : flex_lex();
+}
+
 ast_node *generate_ast()
 {
   type_names = yytname;
   type_count = YYNTOKENS+YYNNTS;
 
   root = NULL;
+  top_stmts = NULL;
 
   yyparse();
 
   return root;
+}
+
+/*
+ * Streaming: instead of building the whole tree, the push parser is fed one
+ * token at a time and each top-level statement is handed out as soon as it is
+ * complete (it is the caller's to free).  Hooks can throw, so they are run
+ * between pushes by the caller instead of from inside the parser's actions.
+ */
+
+static void stream_stmt(ast_node *stmt)
+{
+  if (stream_count == stream_cap)
+  {
+    unsigned i, cap = stream_cap ? stream_cap*2 : 4;
+    ast_node **ready = malloc(cap * sizeof(ast_node*));
+    for (i = 0; i < stream_count; ++i)
+      ready[i] = stream_ready[(stream_head + i) % stream_cap];
+    free(stream_ready);
+    stream_ready = ready;
+    stream_cap = cap;
+    stream_head = 0;
+  }
+  stream_ready[(stream_head + stream_count++) % stream_cap] = stmt;
+}
+
+void stream_ast_open()
+{
+  type_names = yytname;
+  type_count = YYNTOKENS+YYNNTS;
+
+  root = NULL;
+  top_stmts = NULL;
+  program_lineno = 0;
+  stream_head = stream_count = 0;
+  stream_ps = yypstate_new();
+  stream_status = YYPUSH_MORE;
+}
+
+// The next top-level statement (NULL at the end of the program)
+ast_node *stream_ast_next()
+{
+  ast_node *stmt;
+  while (stream_count == 0 && stream_status == YYPUSH_MORE)
+  {
+    yychar = yylex(); // (and yylval)
+    stream_status = yypush_parse(stream_ps);
+  }
+  if (stream_count == 0)
+    return NULL;
+  stmt = stream_ready[stream_head];
+  stream_head = (stream_head + 1) % stream_cap;
+  --stream_count;
+  return stmt;
+}
+
+// 0 if the whole program parsed
+int stream_ast_close()
+{
+  while (stream_ast_next() != NULL)
+    ;
+  yypstate_delete(stream_ps);
+  stream_ps = NULL;
+  if (root != NULL)
+  {
+    free_ast_tree(root);
+    root = NULL;
+  }
+  return stream_status;
 } 
@@ -0,0 +1,182 @@
+#include <string>
+#include <charconv>
+
+#include "insn.hpp"
+
+namespace LOLCode
+{
+  using std::string;
+
+  /*! The names of the registers, by Reg */
+  static const char * const reg_names[] = {
+    "%eax", "%ebx", "%ecx", "%edx", "%esi", "%edi", "%ebp", "%esp",
+    "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7"
+  };
+
+  /*! The mnemonics, by Opcode */
+  static const char * const mnemonics[I_COUNT] = {
+    "",       // I_RAW
+    "",       // I_VERBATIM
+    "",       // I_LABEL
+    "movl",
+    "leal",
+    "push",
+    "pop",
+    "addl",
+    "subl",
+    "call",
+    "int",
+    "pushal",
+    "popal",
+    "imull",
+    "negl",
+    "xorl",
+    "shll",
+    "sarl",
+    "shrl",
+    "cltd",
+    "idivl",
+    "cmpl",
+    "testl",
+    "movq",
+    "movdqu",
+    "movdqa",
+    "paddd",
+    "psubd",
+    "pmuludq",
+    "psrad",
+    "psrld",
+    "pand",
+    "pxor",
+    "jmp",
+    "je",
+    "jne",
+    "jg",
+    "jge",
+    "jl",
+    "jle",
+    "jae",
+  };
+
+  Operand none()
+  {
+    Operand o = { OPERAND_NONE, NOREG, NOREG, 0, 0 };
+    return o;
+  }
+
+  /*!
+   * \param r The register
+   */
+  Operand reg(Reg r)
+  {
+    Operand o = { OPERAND_REG, (unsigned char)r, NOREG, 0, 0 };
+    return o;
+  }
+
+  /*!
+   * \param value The value
+   */
+  Operand imm(int value)
+  {
+    Operand o = { OPERAND_IMM, NOREG, NOREG, 0, value };
+    return o;
+  }
+
+  /*!
+   * \param base The base register
+   * \param disp The displacement from the base register
+   */
+  Operand mem(Reg base, int disp)
+  {
+    Operand o = { OPERAND_MEM, (unsigned char)base, NOREG, 1, disp };
+    return o;
+  }
+
+  /*!
+   * \param base The base register
+   * \param index The index register
+   * \param scale What to multiply the index register by (1, 2, 4 or 8)
+   * \param disp The displacement from the base register
+   */
+  Operand mem(Reg base, Reg index, int scale, int disp)
+  {
+    Operand o = { OPERAND_MEM, (unsigned char)base, (unsigned char)index, (unsigned char)scale, disp };
+    return o;
+  }
+
+  /*!
+   * \param value The number
+   * \param out Where to append it
+   */
+  void render_number(long value, string &out)
+  {
+    char buf[24];
+    std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, r.ptr - buf);
+  }
+
+  /*!
+   * \brief Append the text of one operand to a buffer
+   */
+  static void render_operand(const Operand &o, const vector<string> &strings, string &out)
+  {
+    switch (o.kind)
+    {
+      case OPERAND_REG:
+        out += reg_names[o.base];
+        break;
+      case OPERAND_IMM:
+        out += '$';
+        render_number(o.value, out);
+        break;
+      case OPERAND_MEM:
+        if (o.value != 0 || o.base == NOREG)
+          render_number(o.value, out);
+        out += '(';
+        if (o.base != NOREG)
+          out += reg_names[o.base];
+        if (o.index != NOREG)
+        {
+          out += ',';
+          out += reg_names[o.index];
+          out += ',';
+          render_number(o.scale, out);
+        }
+        out += ')';
+        break;
+      case OPERAND_ADDRESS:
+        out += '$';
+        out += strings[o.value];
+        break;
+      case OPERAND_SYMBOL:
+        out += strings[o.value];
+        break;
+    }
+  }
+
+  /*!
+   * \param insn The instruction
+   * \param strings The string table that the instruction refers to
+   * \param out Where to append the text
+   */
+  void render(const Insn &insn, const vector<string> &strings, string &out)
+  {
+    switch (insn.op)
+    {
+      case I_RAW:
+      case I_VERBATIM:
+        out += strings[insn.text];
+        return;
+      case I_LABEL:
+        render_operand(insn.ops[0], strings, out);
+        out += ':';
+        return;
+    }
+    out += mnemonics[insn.op];
+    for (unsigned i = 0; i < insn.nops; ++i)
+    {
+      out += (i == 0) ? " " : ", ";
+      render_operand(insn.ops[i], strings, out);
+    }
+  }
+}
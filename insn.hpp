@@ -0,0 +1,140 @@
+#ifndef INSN_H
+#define INSN_H
+
+#include <string>
+#include <vector>
+
+/*!
+ * \brief The instructions generated by the compiler
+ *
+ *   The hooks append Insn records to the CompilerContext instead of building
+ * the text of each line as they go.  The text of the whole program is only
+ * rendered once, at the end (see CompilerContext::build_file), so the hooks
+ * do not allocate for every line and later passes can look at (and rewrite)
+ * what was generated.
+ */
+
+namespace LOLCode
+{
+  using std::string;
+  using std::vector;
+
+  /*!
+   * \brief The 32-bit general purpose registers (and the SSE registers)
+   */
+  enum Reg
+  {
+    EAX, EBX, ECX, EDX, ESI, EDI, EBP, ESP,
+    XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+    NOREG
+  };
+
+  /*!
+   * \brief The instructions (and pseudo-instructions) that can be generated
+   */
+  enum Opcode
+  {
+    I_RAW,       /*!< A line of text (directive, label, ...) held in the string table */
+    I_VERBATIM,  /*!< Text held in the string table, written exactly as is (no indent or newline) */
+    I_LABEL,     /*!< A label definition (the symbol operand, followed by a colon) */
+    I_MOVL,
+    I_LEAL,
+    I_PUSH,
+    I_POP,
+    I_ADDL,
+    I_SUBL,
+    I_CALL,
+    I_INT,
+    I_PUSHAL,
+    I_POPAL,
+    I_IMULL,
+    I_NEGL,
+    I_XORL,
+    I_SHLL,
+    I_SARL,
+    I_SHRL,
+    I_CLTD,
+    I_IDIVL,
+    I_CMPL,
+    I_TESTL,
+    I_MOVQ,      /*!< One value_t to or from an SSE register */
+    I_MOVDQU,    /*!< Two value_ts to or from an SSE register */
+    I_MOVDQA,
+    I_PADDD,
+    I_PSUBD,
+    I_PMULUDQ,
+    I_PSRAD,
+    I_PSRLD,
+    I_PAND,
+    I_PXOR,
+    I_JMP,
+    I_JE,
+    I_JNE,
+    I_JG,
+    I_JGE,
+    I_JL,
+    I_JLE,
+    I_JAE,       /*!< (unsigned) */
+    I_COUNT
+  };
+
+  /*!
+   * \brief The kinds of operands
+   */
+  enum OperandKind
+  {
+    OPERAND_NONE,
+    OPERAND_REG,     /*!< %reg */
+    OPERAND_IMM,     /*!< $value */
+    OPERAND_MEM,     /*!< value(base,index,scale) */
+    OPERAND_SYMBOL,  /*!< A symbol used as a branch target or label */
+    OPERAND_ADDRESS  /*!< $symbol */
+  };
+
+  /*!
+   * \brief One operand of an instruction
+   */
+  typedef struct {
+    unsigned char kind;  /*!< One of OperandKind */
+    unsigned char base;  /*!< The register (OPERAND_REG) or base register (OPERAND_MEM) */
+    unsigned char index; /*!< The index register (OPERAND_MEM), or NOREG */
+    unsigned char scale; /*!< The scale of the index register (OPERAND_MEM) */
+    int value;           /*!< The immediate, displacement or string table index of the symbol */
+  } Operand;
+
+  /*!
+   * \brief One line of generated code
+   */
+  typedef struct {
+    unsigned short op;    /*!< One of Opcode */
+    unsigned char depth;  /*!< How many blocks deep the line is (for indentation) */
+    unsigned char nops;   /*!< Number of operands used */
+    Operand ops[2];       /*!< The operands, in AT&T (source, destination) order */
+    unsigned text;        /*!< String table index of the text of an I_RAW or I_VERBATIM line */
+    unsigned comment;     /*!< String table index of the comment (0 for none) */
+    unsigned line;        /*!< The line of the input that generated this (0 for none) */
+  } Insn;
+
+  /*! \brief No operand */
+  Operand none();
+  /*! \brief A register operand */
+  Operand reg(Reg r);
+  /*! \brief An immediate operand */
+  Operand imm(int value);
+  /*! \brief A memory operand: disp(base) */
+  Operand mem(Reg base, int disp = 0);
+  /*! \brief A memory operand: disp(base,index,scale) */
+  Operand mem(Reg base, Reg index, int scale, int disp = 0);
+
+  /*!
+   * \brief Append the text of an instruction (without indentation or comment) to a buffer
+   */
+  void render(const Insn &insn, const vector<string> &strings, string &out);
+
+  /*!
+   * \brief Append a number to a buffer
+   */
+  void render_number(long value, string &out);
+}
+
+#endif
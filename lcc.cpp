@@ -6,19 +6,162 @@ using std::flush;
 using std::ios;
 
 #include <fstream>
-using std::ofstream;
 
 #include <string>
 using std::string;
 
+#include <vector>
+using std::vector;
+
+#include <map>
+using std::map;
+
+#include <sstream>
+using std::ostringstream;
+using std::istringstream;
+
+#include <algorithm>
+using std::sort;
+
+#include <iomanip>
+using std::setw;
+using std::setprecision;
+
 #include "lolcode.hpp"
+#include "printer.hpp"
 using namespace LOLCode;
 
+#include <cerrno>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <csignal>
 #include <malloc.h>
 #include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <ext/stdio_filebuf.h>
 
 #include "ast.h"
+#include "fastlex.h"
+#include "memstat.h"
+
+extern "C"
+{
+  extern unsigned long lineno;
+}
+
+/*!
+ * \brief What one phase of the compile cost (see -T)
+ */
+typedef struct {
+  const char *name;         /*!< The name of the phase */
+  double seconds;           /*!< Wall time */
+  long peak_rss_kb;         /*!< Peak resident set size of the process at the end of the phase */
+  unsigned long allocs;     /*!< Heap allocations made during the phase */
+  unsigned long long bytes; /*!< Bytes requested by those allocations */
+  struct timespec start;    /*!< When the phase started */
+  memstat_t mem;            /*!< The allocation counters when the phase started */
+} PhaseStats;
+
+/*!
+ * Start timing a phase
+ */
+
+void phase_start(PhaseStats &phase, const char *name)
+{
+  phase.name = name;
+  memstat_get(&phase.mem);
+  clock_gettime(CLOCK_MONOTONIC, &phase.start);
+}
+
+/*!
+ * Finish timing a phase and add it to the list of finished phases
+ */
+
+void phase_end(PhaseStats &phase, vector<PhaseStats> &phases)
+{
+  struct timespec end;
+  struct rusage usage;
+  memstat_t mem;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  memstat_get(&mem);
+  getrusage(RUSAGE_SELF, &usage);
+  phase.seconds = (end.tv_sec - phase.start.tv_sec) + (end.tv_nsec - phase.start.tv_nsec) / 1e9;
+  phase.peak_rss_kb = usage.ru_maxrss;
+  phase.allocs = mem.allocs - phase.mem.allocs;
+  phase.bytes = mem.bytes - phase.mem.bytes;
+  phases.push_back(phase);
+}
+
+/*!
+ * Order hooks by the time spent in the hook itself (most first)
+ */
+
+bool by_self_time(const std::pair<string,HookStats> &a, const std::pair<string,HookStats> &b)
+{
+  return a.second.self_seconds > b.second.self_seconds;
+}
+
+/*!
+ * Print the statistics gathered for -T, either as a table or as JSON
+ */
+
+void print_timing(std::ostream &out, const vector<PhaseStats> &phases, const CompilerContext &context, bool json)
+{
+  vector< std::pair<string,HookStats> > hooks(context.hook_stats.begin(), context.hook_stats.end());
+  sort(hooks.begin(), hooks.end(), by_self_time);
+
+  out << std::fixed;
+  if (json)
+  {
+    out << "{\"phases\": [";
+    for (unsigned i = 0; i < phases.size(); ++i)
+    {
+      out << (i ? ", " : "") << "{\"name\": \"" << phases[i].name << "\""
+          << ", \"seconds\": " << setprecision(6) << phases[i].seconds
+          << ", \"peak_rss_kb\": " << phases[i].peak_rss_kb
+          << ", \"allocs\": " << phases[i].allocs
+          << ", \"alloc_bytes\": " << phases[i].bytes << "}";
+    }
+    out << "], \"hooks\": [";
+    for (unsigned i = 0; i < hooks.size(); ++i)
+    {
+      out << (i ? ", " : "") << "{\"rule\": \"" << hooks[i].first << "\""
+          << ", \"calls\": " << hooks[i].second.calls
+          << ", \"seconds\": " << setprecision(6) << hooks[i].second.seconds
+          << ", \"self_seconds\": " << hooks[i].second.self_seconds << "}";
+    }
+    out << "]}" << endl;
+    return;
+  }
+
+  out << setw(16) << "phase" << setw(12) << "ms" << setw(14) << "peak RSS kB"
+      << setw(12) << "allocs" << setw(14) << "alloc bytes" << endl;
+  for (unsigned i = 0; i < phases.size(); ++i)
+  {
+    out << setw(16) << phases[i].name << setw(12) << setprecision(3) << phases[i].seconds*1e3
+        << setw(14) << phases[i].peak_rss_kb << setw(12) << phases[i].allocs
+        << setw(14) << phases[i].bytes << endl;
+  }
+  if (hooks.empty())
+    return;
+  out << endl;
+  out << setw(16) << "hook" << setw(12) << "calls" << setw(12) << "total ms" << setw(12) << "self ms" << endl;
+  for (unsigned i = 0; i < hooks.size(); ++i)
+  {
+    out << setw(16) << hooks[i].first << setw(12) << hooks[i].second.calls
+        << setw(12) << setprecision(3) << hooks[i].second.seconds*1e3
+        << setw(12) << hooks[i].second.self_seconds*1e3 << endl;
+  }
+}
 
 
 /*!
@@ -27,41 +170,589 @@ using namespace LOLCode;
 
 void usage(const char *progname)
 {
-  cerr << "Usage: " << progname << " [-Cvcpo]" << endl;
+  cerr << "Usage: " << progname << " [-CvcpEFoTg] [-rt archive] [-profile] [-no-vectorize] [-no-promote] [-no-comments]" << endl;
+  cerr << "           [-stream] [-serve socket | -client socket] [file]" << endl;
+  cerr << "  (the program is read from <file>, or from standard input)" << endl;
   cerr << "  -v           Verbose output" << endl;
   cerr << "  -C           Check only (enable verbose output and disable compiling)" << endl;
   cerr << "  -c           Compile into Assembly (default)" << endl;
   cerr << "  -p           Print out the nodes in the A.S.T. (advanced)" << endl;
-  cerr << "  -o <file>    Write compiler output to <file> (default: out.s)" << endl;
+  cerr << "  -E           Echo the program back as (normalized) LOLCODE" << endl;
+  cerr << "  -F           Use the hand-written (vectorized) scanner instead of flex" << endl;
+  cerr << "  -o <file>    Write compiler output to <file> (default: out.s); unless the name ends" << endl;
+  cerr << "               in .s, it is assembled and linked into a program" << endl;
+  cerr << "  -rt <file>   Link programs with this runtime archive (default: liblolrt.a next to lcc)" << endl;
+  cerr << "  -T[json]     Report time, memory and allocations per phase and per hook to stderr" << endl;
+  cerr << "  -g           Emit line info and CFI, so debuggers and perf can map the program back to its lines" << endl;
+  cerr << "  -no-comments Leave the comments (and so the # <- [file:line] marks) out of the assembly" << endl;
+  cerr << "  -profile     Make the program report executions and cycles per source line at exit" << endl;
+  cerr << "  -no-vectorize  Do not use SSE2 for element-wise loops over BUKKITs" << endl;
+  cerr << "  -no-promote  Keep variables that are never indexed in the runtime too" << endl;
+  cerr << "  -stream      Compile and write out each top-level statement as soon as it is parsed" << endl;
+  cerr << "  -serve <socket>   Run a compile server on a Unix socket (until killed)" << endl;
+  cerr << "  -client <socket>  Have the compile server on <socket> compile the program" << endl;
   exit(1);
 }
 
+/*!
+ * Print an error from compiling
+ */
+
+void report_error(const HookError &e, std::ostream &out = cout)
+{
+  out << "Error in compiling:" << endl;
+  out << "  " << e.to_string() << endl;
+  out << "Call stack:" << endl;
+  out << e.backtrace() << flush; // appends newline for us
+}
+
+/*!
+ * \brief Where the compiled program goes
+ *
+ *   An output file ending in .s gets the assembly.  Anything else is an
+ * executable: the assembly is piped to "gcc -m32 -c -x assembler -", which
+ * assembles it into a memfd_create file, and that is then linked (as
+ * /proc/self/fd/N) against the runtime archive (liblolrt.a).  Only the
+ * program itself is written to disk: there's no .s or .o on the way (and no
+ * linker plugin, which would want a temporary file of its own).  $LOLCC
+ * names a different compiler driver.
+ */
+typedef struct {
+  string file;          /*!< The file being written */
+  string runtime;       /*!< The runtime archive to link with */
+  pid_t assembler;      /*!< The compiler driver reading the assembly (0 if the assembly is the output) */
+  int object;           /*!< The memfd the object is assembled into (-1 if none) */
+  std::streambuf *buf;  /*!< Where the assembly is written */
+  std::ostream *out;    /*!< A stream on buf */
+} Output;
+
+/*!
+ * \brief Whether a file name asks for assembly (rather than a program)
+ */
+
+bool is_assembly(const string &file)
+{
+  return file.size() > 2 && file.compare(file.size() - 2, 2, ".s") == 0;
+}
+
+/*!
+ * \brief The runtime archive to link with: liblolrt.a next to lcc, unless -rt gave one
+ */
+
+string runtime_archive(const string &given)
+{
+  if (!given.empty())
+    return given;
+  char self[4096];
+  ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+  if (len <= 0)
+    return "liblolrt.a";
+  string dir(self, len);
+  return dir.substr(0, dir.rfind('/') + 1) + "liblolrt.a";
+}
+
+/*!
+ * \brief Run the compiler driver ($LOLCC, or gcc) with some arguments
+ *
+ * \param input What it reads as standard input (-1 to leave it alone)
+ * \return Its pid (0 if it couldn't be started)
+ */
+
+pid_t start_driver(const vector<string> &args, int input)
+{
+  const char *cc = getenv("LOLCC");
+  if (cc == NULL || *cc == '\0')
+    cc = "gcc";
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    perror("fork");
+    return 0;
+  }
+  if (pid == 0)
+  {
+    if (input >= 0)
+    {
+      dup2(input, 0);
+      close(input);
+    }
+    vector<char*> argv;
+    argv.push_back(const_cast<char*>(cc));
+    for (unsigned i = 0; i < args.size(); ++i)
+      argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(NULL);
+    execvp(cc, &argv[0]);
+    perror(cc);
+    _exit(127);
+  }
+  return pid;
+}
+
+/*!
+ * \brief Wait for the compiler driver
+ *
+ * \return Whether it succeeded
+ */
+
+bool wait_driver(pid_t pid)
+{
+  int status;
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/*!
+ * \brief Start writing the output (and the compiler driver, for a program)
+ *
+ * \return false (after saying why) if it couldn't be opened
+ */
+
+bool open_output(Output &output, const string &file, const string &runtime)
+{
+  output.file = file;
+  output.runtime = runtime;
+  output.assembler = 0;
+  output.object = -1;
+  output.buf = NULL;
+  output.out = NULL;
+  if (is_assembly(file))
+  {
+    std::filebuf *fb = new std::filebuf;
+    output.buf = fb;
+    output.out = new std::ostream(fb);
+    if (fb->open(file.c_str(), ios::out) == NULL)
+    {
+      perror(file.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  output.object = memfd_create("lcc-object", 0); // (the driver inherits it)
+  if (output.object < 0)
+  {
+    perror("memfd_create");
+    return false;
+  }
+  int fds[2];
+  if (pipe(fds) != 0)
+  {
+    perror("pipe");
+    return false;
+  }
+  // the driver's exit status says what went wrong, not a SIGPIPE
+  signal(SIGPIPE, SIG_IGN);
+  vector<string> args = { "-m32", "-c", "-pipe", "-x", "assembler", "-",
+                          "-o", "/proc/self/fd/" + std::to_string(output.object) };
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  output.assembler = start_driver(args, fds[0]);
+  close(fds[0]);
+  if (output.assembler == 0)
+  {
+    close(fds[1]);
+    return false;
+  }
+  output.buf = new __gnu_cxx::stdio_filebuf<char>(fds[1], ios::out, 1 << 16);
+  output.out = new std::ostream(output.buf);
+  return true;
+}
+
+/*!
+ * \brief Finish writing the output
+ *
+ *   For a program, the object is linked once it has been assembled.  If the
+ * program didn't compile, the compiler driver is stopped and the output file
+ * removed.
+ *
+ * \return false if the program didn't compile or couldn't be written, assembled or linked
+ */
+
+bool close_output(Output &output, bool ok)
+{
+  if (output.out != NULL)
+  {
+    output.out->flush();
+    ok = ok && output.out->good();
+  }
+  if (output.assembler != 0 && !ok)
+    kill(output.assembler, SIGTERM);
+  delete output.out; // (closes the file or pipe)
+  delete output.buf;
+  output.out = NULL;
+  output.buf = NULL;
+  if (output.assembler != 0)
+  {
+    bool built = wait_driver(output.assembler);
+    if (built && ok)
+    { // (the generated code uses absolute addresses, so not a PIE)
+      vector<string> args = { "-m32", "-no-pie", "-fno-use-linker-plugin",
+                              "/proc/self/fd/" + std::to_string(output.object),
+                              "-x", "none", output.runtime, "-o", output.file };
+      pid_t linker = start_driver(args, -1);
+      built = (linker != 0 && wait_driver(linker));
+    }
+    if (!built)
+    {
+      if (ok)
+        cerr << "Could not assemble and link " << output.file << endl;
+      ok = false;
+    }
+    output.assembler = 0;
+  }
+  if (output.object >= 0)
+    close(output.object);
+  output.object = -1;
+  if (!ok)
+    remove(output.file.c_str());
+  return ok;
+}
+
+/*!
+ * Compile with -stream: each statement is written out as soon as it is parsed
+ *
+ * The output file is removed if the program doesn't compile.
+ */
+
+int compile_streamed(const string &output_file, const string &runtime, CompilerContext &context, bool timing_json)
+{
+  vector<PhaseStats> phases;
+  PhaseStats phase;
+
+  bool parsed = false;
+  Output output;
+  if (!open_output(output, output_file, runtime))
+  {
+    close_output(output, false);
+    return 1;
+  }
+  try
+  {
+    phase_start(phase, "stream");
+    parsed = compile_stream(context, *output.out);
+    parsed = close_output(output, parsed);
+    phase_end(phase, phases);
+  }
+  catch (HookError e)
+  {
+    report_error(e);
+    close_output(output, false);
+    parsed = false;
+  }
+  if (context.timing && !phases.empty())
+    print_timing(cerr, phases, context, timing_json);
+  return parsed ? 0 : 1;
+}
+
+/*
+ * lcc -serve <socket> keeps one compiler running for clients (lcc -client
+ * <socket>) to send their programs to, so they don't each pay for starting
+ * it up: the rules' hooks stay resolved, and the A.S.T. pool and scanner
+ * buffers stay allocated.
+ *
+ *   The client sends a line with its options (-profile, -no-vectorize,
+ * -no-promote, -g, -no-comments and last -file and the name of the program's
+ * file) and then the program, and shuts down its end.  The server
+ * answers with a line holding 0 and the assembly, or 1 and what went wrong,
+ * and closes the connection.  The client writes (or assembles and links) the output itself.
+ */
+
+/*!
+ * \brief Write all of a buffer to a file descriptor
+ */
+
+bool write_all(int fd, const char *data, size_t size)
+{
+  while (size > 0)
+  {
+    ssize_t wrote = write(fd, data, size);
+    if (wrote < 0 && errno == EINTR)
+      continue;
+    if (wrote <= 0)
+      return false;
+    data += wrote;
+    size -= wrote;
+  }
+  return true;
+}
+
+/*!
+ * \brief Read from a file descriptor until the end
+ */
+
+bool read_all(int fd, string &data)
+{
+  char buf[65536];
+  while (true)
+  {
+    ssize_t got = read(fd, buf, sizeof(buf));
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got < 0)
+      return false;
+    if (got == 0)
+      return true;
+    data.append(buf, got);
+  }
+}
+
+/*!
+ * \brief The address of a socket file
+ *
+ * \return false (after saying why) if the path is too long
+ */
+
+bool socket_address(const string &path, struct sockaddr_un &addr)
+{
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+  {
+    cerr << "Socket path too long: " << path << endl;
+    return false;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+/*!
+ * \brief Compile one program for a client
+ *
+ *   The parser reports errors on stderr, so that is pointed at a temporary
+ * file while it runs.
+ *
+ * \param options The client's options
+ * \param source The program
+ * \param reply Set to the assembly, or to what went wrong
+ * \return Whether it compiled
+ */
+
+bool compile_request(const string &options, const string &source, string &reply)
+{
+  CompilerContext context;
+  size_t file = options.find(" -file "); // (the name may have anything in it)
+  if (file != string::npos)
+    context.filename = options.substr(file + 7);
+  istringstream words(options.substr(0, file));
+  string word;
+  while (words >> word)
+  {
+    if (word == "-profile")
+      context.flags["profile"] = true;
+    else if (word == "-no-vectorize")
+      context.flags["no_vectorize"] = true;
+    else if (word == "-no-promote")
+      context.flags["no_promote"] = true;
+    else if (word == "-g")
+      context.debug = true;
+    else if (word == "-no-comments")
+      context.comments = false;
+  }
+
+  FILE *errors = tmpfile();
+  int saved_stderr = dup(2);
+  fflush(stderr);
+  if (errors != NULL)
+    dup2(fileno(errors), 2);
+
+  ostringstream messages;
+  bool ok = false;
+  fastlex_open_buffer(source.data(), source.size());
+  lineno = 0;
+  ASTNode *root = generate_ast();
+  if (root != NULL)
+  {
+    try
+    {
+      run_hook(root, context);
+      reply = context.build_file();
+      ok = true;
+    }
+    catch (HookError e)
+    {
+      report_error(e, messages);
+    }
+  }
+  ast_reset(); // (the parts of a tree that didn't parse too)
+
+  fflush(stderr);
+  dup2(saved_stderr, 2);
+  close(saved_stderr);
+  if (errors != NULL)
+  {
+    string parse_errors;
+    rewind(errors);
+    read_all(fileno(errors), parse_errors);
+    fclose(errors);
+    if (!ok)
+      reply = parse_errors;
+  }
+  if (!ok)
+    reply += messages.str();
+  return ok;
+}
+
+/*!
+ * Run the compile server (lcc -serve)
+ *
+ * Only returns (with 1) if the socket can't be set up.
+ */
+
+int serve(const string &path)
+{
+  struct sockaddr_un addr;
+  if (!socket_address(path, addr))
+    return 1;
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0)
+  {
+    perror("socket");
+    return 1;
+  }
+  struct stat old;
+  if (lstat(path.c_str(), &old) == 0 && S_ISSOCK(old.st_mode))
+    unlink(path.c_str()); // (left behind by an earlier server; anything else is not ours to remove)
+  if (bind(server, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 64) != 0)
+  {
+    perror(path.c_str());
+    close(server);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN); // (a client that went away)
+  use_fastlex = 1;
+
+  while (true)
+  {
+    int client = accept(server, NULL, NULL);
+    if (client < 0)
+    {
+      if (errno != EINTR)
+        perror("accept");
+      continue;
+    }
+    string request, reply;
+    if (read_all(client, request))
+    {
+      size_t newline = request.find('\n');
+      if (newline == string::npos)
+        newline = request.size();
+      bool ok = compile_request(request.substr(0, newline), request.substr(std::min(newline + 1, request.size())), reply);
+      string status = ok ? "0\n" : "1\n";
+      if (write_all(client, status.data(), status.size()))
+        write_all(client, reply.data(), reply.size());
+    }
+    close(client);
+  }
+}
+
+/*!
+ * Compile the program on a compile server (lcc -client)
+ */
+
+int compile_remote(const string &path, const string &output_file, const string &runtime, CompilerContext &context)
+{
+  struct sockaddr_un addr;
+  if (!socket_address(path, addr))
+    return 1;
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0 || connect(server, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+  {
+    perror(path.c_str());
+    if (server >= 0)
+      close(server);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  string request = string(context.flags["profile"] ? " -profile" : "") +
+                   (context.flags["no_vectorize"] ? " -no-vectorize" : "") +
+                   (context.flags["no_promote"] ? " -no-promote" : "") +
+                   (context.debug ? " -g" : "") + (context.comments ? "" : " -no-comments") +
+                   " -file " + context.filename + "\n";
+  if (!read_all(0, request))
+  {
+    perror("stdin");
+    close(server);
+    return 1;
+  }
+  string reply;
+  bool sent = write_all(server, request.data(), request.size());
+  shutdown(server, SHUT_WR);
+  if (!sent || !read_all(server, reply) || reply.size() < 2)
+  {
+    cerr << "No answer from the compile server on " << path << endl;
+    close(server);
+    return 1;
+  }
+  close(server);
+
+  if (reply[0] != '0')
+  {
+    cout << reply.substr(2) << flush;
+    return 1;
+  }
+  Output output;
+  bool written = open_output(output, output_file, runtime);
+  if (written)
+    output.out->write(reply.data() + 2, reply.size() - 2);
+  return close_output(output, written) ? 0 : 1;
+}
+
 /*!
  * Program execution entry point
  */
 
 int main(int argc, char **argv)
 {
-  static char *options = "Cvcpo:";
+  static const char *options = "CvcpEFo:T::g";
+  static const struct option long_options[] = {
+    { "profile", no_argument, NULL, 'P' },
+    { "no-vectorize", no_argument, NULL, 'V' },
+    { "no-promote", no_argument, NULL, 'N' },
+    { "no-comments", no_argument, NULL, 'M' },
+    { "stream", no_argument, NULL, 'S' },
+    { "rt", required_argument, NULL, 'R' },
+    { "serve", required_argument, NULL, 'L' },
+    { "client", required_argument, NULL, 'K' },
+    { NULL, 0, NULL, 0 }
+  };
 
   bool verbose = false;
   bool compile = true;
   bool print_ast = false;
+  bool echo = false;
+  bool timing = false;
+  bool timing_json = false;
+  bool profile = false;
+  bool vectorize = true;
+  bool promote = true;
+  bool stream = false;
+  bool debug = false;
+  bool comments = true;
+  vector<PhaseStats> phases;
+  PhaseStats phase;
 
   string output_file = "out.s";
+  string runtime;
+  string serve_socket;
+  string client_socket;
 
   // option parsing
   while (true)
   {
-    static char c;
+    static int c;
     opterr = 0;
-    c = getopt(argc, argv, options);
+    c = getopt_long_only(argc, argv, options, long_options, NULL);
     if (c == -1) break;
     switch (c)
     {
       case 'p':
         print_ast = true;
         break;
+      case 'E':
+        echo = true;
+        break;
+      case 'F':
+        use_fastlex = 1;
+        break;
       case 'v':
         verbose = true;
         break;
@@ -75,6 +766,37 @@ int main(int argc, char **argv)
       case 'o':
         output_file = string(optarg);
         break;
+      case 'P':
+        profile = true;
+        break;
+      case 'V':
+        vectorize = false;
+        break;
+      case 'N':
+        promote = false;
+        break;
+      case 'S':
+        stream = true;
+        break;
+      case 'g':
+        debug = true;
+        break;
+      case 'M':
+        comments = false;
+        break;
+      case 'R':
+        runtime = string(optarg);
+        break;
+      case 'L':
+        serve_socket = string(optarg);
+        break;
+      case 'K':
+        client_socket = string(optarg);
+        break;
+      case 'T':
+        timing = true;
+        timing_json = (optarg != NULL && string(optarg) == "json");
+        break;
       default:
         cerr << "Unrecognized option: -" << (char)((c=='?')?optopt:c) << endl;
         usage(*argv);
@@ -82,7 +804,53 @@ int main(int argc, char **argv)
     }
   }
 
+  if (!serve_socket.empty())
+    return serve(serve_socket);
+
+  CompilerContext context;
+  context.timing = timing;
+  context.flags["profile"] = profile;
+  context.flags["no_vectorize"] = !vectorize;
+  context.flags["no_promote"] = !promote;
+  context.debug = debug;
+  context.comments = comments;
+  if (optind + 1 < argc)
+    usage(*argv);
+  if (optind < argc)
+  { // (the scanners all read standard input)
+    if (freopen(argv[optind], "r", stdin) == NULL)
+    {
+      perror(argv[optind]);
+      return 1;
+    }
+    context.filename = argv[optind];
+  }
+
+  if (!client_socket.empty())
+  { // the server only sends back the assembly
+    if (print_ast || echo || !compile || stream || timing)
+    {
+      cerr << "-client can't be used with -C, -p, -E, -T or -stream" << endl;
+      usage(*argv);
+    }
+    return compile_remote(client_socket, output_file, runtime_archive(runtime), context);
+  }
+
+  if (stream)
+  { // there is never a whole tree to print
+    if (print_ast || echo || !compile)
+    {
+      cerr << "-stream can't be used with -C, -p or -E" << endl;
+      usage(*argv);
+    }
+    if (use_fastlex)
+      fastlex_open_stream(stdin);
+    return compile_streamed(output_file, runtime_archive(runtime), context, timing_json);
+  }
+
+  phase_start(phase, "generate_ast");
   ASTNode *root = generate_ast();
+  phase_end(phase, phases);
 
   if (root == NULL)
   {
@@ -95,27 +863,54 @@ int main(int argc, char **argv)
   if (print_ast)
     print_tree(root, 0);
   
-  CompilerContext context;
+  if (echo)
+  {
+    try
+    {
+      pretty_print(root, cout);
+    }
+    catch (HookError e)
+    {
+      cerr << "Error in printing: " << e.to_string() << endl;
+      return 1;
+    }
+  }
   try
   {
     if (compile)
     {
-      HookFunc run = hook_search( type_names[root->type] );
-      run(root, context);
-      
-      ofstream fout(output_file.c_str(), ios::out);
-      fout << context.build_file() << std::flush;
-      fout.close();
+      phase_start(phase, "hooks");
+      run_hook(root, context);
+      phase_end(phase, phases);
+
+      phase_start(phase, "build_file");
+      string text = context.build_file();
+      phase_end(phase, phases);
+
+      phase_start(phase, "write");
+      Output output;
+      bool written = open_output(output, output_file, runtime_archive(runtime));
+      if (written)
+        *output.out << text;
+      written = close_output(output, written);
+      phase_end(phase, phases);
+      if (!written)
+      {
+        if (timing)
+          print_timing(cerr, phases, context, timing_json);
+        return 1;
+      }
     }
   }
   catch (HookError e)
   {
-    cout << "Error in compiling:" << endl;
-    cout << "  " << e.to_string() << endl;
-    cout << "Call stack:" << endl;
-    cout << e.backtrace() << flush; // appends newline for us
+    report_error(e);
+    if (timing)
+      print_timing(cerr, phases, context, timing_json);
     return 1;
   }
 
+  if (timing)
+    print_timing(cerr, phases, context, timing_json);
   return (root == NULL);
 }
@@ -1,12 +1,14 @@
 #include <string>
 #include <iostream>
-using std::cout;
 using std::cerr;
 using std::endl;
 
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <ctime>
+#include <cstring>
+#include <climits>
 
 #include "lolcode.hpp"
 #include "asmutil.h"
@@ -21,19 +23,12 @@ namespace LOLCode
    */
 
   CompilerContext::CompilerContext()
-    : counter(0), filename("stdin")
+    : counter(0), filename("stdin"), stack_depth(0), timing(false), child_seconds(0), flushed(false),
+      debug(false), comments(true), cfa_depth(0)
   {
+    strings.push_back(""); // index 0 is "no string"
   }
 
-  const string CompilerContext::ret_reg("%eax");
-  const string CompilerContext::var_reg("%ebx");
-  const string CompilerContext::cnt_reg("%ecx");
-  const string CompilerContext::val_reg("%edx");
-  const string CompilerContext::dim_reg("%esi");
-  const string CompilerContext::ptr_reg("%edi");
-  const string CompilerContext::frame_ptr("%ebp");
-  const string CompilerContext::stack_ptr("%esp");
-
   /*!
    * \brief Append a newline and queue for output
    *
@@ -41,21 +36,15 @@ namespace LOLCode
    * that will be written to the file in the "program" section
    *
    * \param piece The piece to be written to the file with newline and comment
-   * \param lineno The line number of the *input file* which generated this line
+   * \param comment The comment to put at the end of the line (if any)
    */
 
   void CompilerContext::output(string piece, string comment)
   {
-    string line;
-    line += string( context_stack.size()*2, ' ' ); // indent
-    line += piece;
+    Insn insn = { I_RAW, (unsigned char)context_stack.size(), 0, { none(), none() }, intern(piece), 0, 0 };
     if (comment.size() > 0)
-    {
-      line += string( 3, ' ' );
-      line += string( tab_width - (line.size()%tab_width), ' ' );
-      line += "# " + comment;
-    }
-    output_raw(line + "\n");
+      insn.comment = intern(comment);
+    insns.push_back(insn);
   }
 
   /*!
@@ -70,16 +59,8 @@ namespace LOLCode
 
   void CompilerContext::output(string piece, unsigned lineno)
   {
-    string comment;
-    if (lineno > 0)
-    {
-      comment += "<- [";
-      comment += filename;
-      comment += ":";
-      comment += convert<unsigned,string>(lineno);
-      comment += "]";
-    }
-    output(piece, comment);
+    output(piece);
+    insns.back().line = lineno;
   }
 
   /*!
@@ -93,7 +74,103 @@ namespace LOLCode
 
   void CompilerContext::output_raw(string piece)
   {
-    file_pieces.push_back(piece);
+    Insn insn = { I_VERBATIM, 0, 0, { none(), none() }, intern(piece), 0, 0 };
+    insns.push_back(insn);
+  }
+
+  /*!
+   * \brief Queue an instruction for output (with debugging info)
+   *
+   * Instructions that move %esp (push, pop and adding or subtracting an
+   * immediate) update stack_depth, so variables can be found relative to it.
+   * When debug is set, a change in stack_depth since the last instruction
+   * (whether it moved %esp or a hook set it back after a jump) is described
+   * to the debugger with a .cfi_def_cfa_offset in front of this one.
+   *
+   * \param op The instruction
+   * \param a The first (source) operand, if any
+   * \param b The second (destination) operand, if any
+   * \param lineno The line number of the *input file* which generated this instruction
+   */
+
+  void CompilerContext::emit(Opcode op, Operand a, Operand b, unsigned lineno)
+  {
+    if (debug && cfa_depth != stack_depth)
+    { // (%esp and the return address)
+      string directive = ".cfi_def_cfa_offset ";
+      render_number(stack_depth + 4, directive);
+      output(directive);
+      cfa_depth = stack_depth;
+    }
+    Insn insn = { (unsigned short)op, (unsigned char)context_stack.size(), 0, { a, b }, 0, 0, lineno };
+    insn.nops = (a.kind == OPERAND_NONE) ? 0 : (b.kind == OPERAND_NONE) ? 1 : 2;
+    insns.push_back(insn);
+
+    bool to_esp = (b.kind == OPERAND_REG && b.base == ESP && a.kind == OPERAND_IMM);
+    switch (op)
+    {
+      case I_PUSH:   stack_depth += 4; break;
+      case I_POP:    stack_depth -= 4; break;
+      case I_PUSHAL: stack_depth += 32; break;
+      case I_POPAL:  stack_depth -= 32; break;
+      case I_ADDL:   if (to_esp) stack_depth -= a.value; break;
+      case I_SUBL:   if (to_esp) stack_depth += a.value; break;
+      default: break;
+    }
+  }
+
+  /*!
+   * \brief Queue an instruction for output (with a comment)
+   *
+   * \param op The instruction
+   * \param a The first (source) operand, if any
+   * \param b The second (destination) operand, if any
+   * \param comment The comment to put at the end of the line
+   */
+
+  void CompilerContext::emit(Opcode op, Operand a, Operand b, const string &comment)
+  {
+    emit(op, a, b);
+    insns.back().comment = intern(comment);
+  }
+
+  /*!
+   * \brief Look up (or add) a string in the string table
+   *
+   * \param text The string
+   * \return The index of the string in strings
+   */
+
+  unsigned CompilerContext::intern(const string &text)
+  {
+    std::pair<map<string,unsigned>::iterator,bool> found =
+      string_ids.insert(std::make_pair(text, (unsigned)strings.size()));
+    if (found.second)
+      strings.push_back(text);
+    return found.first->second;
+  }
+
+  /*!
+   * \brief Refer to a symbol (as the target of a call or jump)
+   */
+
+  Operand CompilerContext::symbol(const string &name)
+  {
+    Operand o = none();
+    o.kind = OPERAND_SYMBOL;
+    o.value = intern(name);
+    return o;
+  }
+
+  /*!
+   * \brief Refer to the address of a symbol (as an immediate)
+   */
+
+  Operand CompilerContext::address(const string &name)
+  {
+    Operand o = symbol(name);
+    o.kind = OPERAND_ADDRESS;
+    return o;
   }
 
   /*!
@@ -111,14 +188,14 @@ namespace LOLCode
     string line;
     line += string( context_stack.size()*2, ' ' ); // indent
     line += piece;
-    if (lineno > 0)
+    if (lineno > 0 && comments)
     {
       line += string( 3, ' ' );
       line += string( tab_width - (line.size()%tab_width), ' ' );
       line += "# <- [";
       line += filename;
       line += ":";
-      line += convert<unsigned,string>(lineno);
+      render_number(lineno, line);
       line += "]";
     }
     header_raw(line + "\n");
@@ -141,33 +218,100 @@ namespace LOLCode
   /*!
    * \brief Return the contents of the output file
    *
-   * Stick all of the pieces together into one string suitable for writing
-   * to the output file and return it
+   * Stick all of the pieces together and render the instructions into one
+   * string suitable for writing to the output file and return it
    */
 
   string CompilerContext::build_file()
   {
     string output;
+    output.reserve(insns.size() * 32);
     for (unsigned i = 0; i < header_pieces.size(); ++i)
       output += header_pieces[i];
     output += "\n";
-    for (unsigned i = 0; i < file_pieces.size(); ++i)
-      output += file_pieces[i];
+    render_insns(output);
     return output;
   }
 
   /*!
-   * \param i The input value
-   * \return The converted value
+   * \brief Return what has been generated since the last flush and forget it
+   *
+   * This is for compiling a piece at a time (see compile_stream).  The first
+   * flush is the start of the file that build_file would return; after that,
+   * any new header pieces are put back in the data section in front of the
+   * instructions.
    */
-  template <typename IN, typename OUT>
-  OUT convert(IN i)
+
+  string CompilerContext::flush()
   {
-    std::stringstream ss;
-    OUT o;
-    ss << i;
-    ss >> o;
-    return o;
+    string output;
+    if (flushed && !header_pieces.empty())
+      output += ".section .data\n";
+    for (unsigned i = 0; i < header_pieces.size(); ++i)
+      output += header_pieces[i];
+    if (!flushed)
+      output += "\n";
+    else if (!header_pieces.empty())
+      output += ".section .text\n";
+    render_insns(output);
+
+    header_pieces.clear();
+    insns.clear();
+    strings.resize(1);
+    string_ids.clear();
+    flushed = true;
+    return output;
+  }
+
+  /*!
+   * \brief Render the instructions and append them to a buffer
+   *
+   * When debug is set, the first instruction from each line of the input is
+   * preceded by a .loc for it.
+   */
+
+  void CompilerContext::render_insns(string &output)
+  {
+    unsigned loc = 0;
+    for (unsigned i = 0; i < insns.size(); ++i)
+    {
+      const Insn &insn = insns[i];
+      if (insn.op == I_VERBATIM)
+      {
+        output += strings[insn.text];
+        continue;
+      }
+      if (debug && insn.line != 0 && insn.line != loc)
+      {
+        output.append(insn.depth*2, ' ');
+        output += ".loc 1 ";
+        render_number(insn.line, output);
+        output += '\n';
+        loc = insn.line;
+      }
+      size_t start = output.size();
+      output.append(insn.depth*2, ' '); // indent
+      render(insn, strings, output);
+      if (comments && (insn.comment != 0 || insn.line != 0))
+      {
+        output.append(3, ' ');
+        output.append(tab_width - ((output.size() - start) % tab_width), ' ');
+        output += "# ";
+        if (insn.comment != 0)
+        {
+          output += strings[insn.comment];
+        }
+        else
+        {
+          output += "<- [";
+          output += filename;
+          output += ":";
+          render_number(insn.line, output);
+          output += "]";
+        }
+      }
+      output += '\n';
+    }
   }
 
   /*!
@@ -254,412 +398,2109 @@ namespace LOLCode
   }
 
   /*!
-   * \brief Outer program block
+   * \brief The hook for a rule, by its number in type_names
    *
-   * This handles the generalized program set-up and destruction.
-   * 
+   *   Each rule is only looked up by name the first time it is seen.
+   */
+
+  static HookFunc hook_for(unsigned type)
+  {
+    static vector<HookFunc> resolved;
+    if (resolved.size() < type_count)
+      resolved.resize(type_count, NULL);
+    if (resolved[type] == NULL)
+      resolved[type] = hook_search( type_names[type] );
+    return resolved[type];
+  }
+
+  /*!
+   * Run the hook for the rule that generated a node.  When the context is
+   * timing, the call is counted and its wall time is charged to the rule,
+   * both in total and less the time spent in the hooks that it ran.
    * \param node The node to traverse
    * \param context The compiler context
-   * \return The standard hook return
-   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   * \throw HookError If the hook is not found (or from the hook itself)
    */
-
-  void program(ASTNode *node, CompilerContext &context) 
-  { 
-    string rule = type_names[node->type];
-    unsigned line = node->lineno;
-    try
+  void run_hook(ASTNode *node, CompilerContext &context)
+  {
+    HookFunc func = hook_for(node->type);
+    if (!context.timing)
     {
-      context.header(".section .data");
-      context.output(".section .text");
-      context.output(".globl main");
-      context.output("main:", line);
-      cout << "HAI" << endl;
-      context.context_stack.push("program");
-      context.varcontext_stack.push("global");
-     
-      if (!node->terminal)
-      {
-        for (unsigned i = 0; i < node->nodecount; ++i)
-        {
-          ASTNode *child = (ASTNode*)node->nodes[i];
-          string child_rule = type_names[child->type];
-          hook_search(child_rule)(child, context);
-        }
-      }
+      func(node, context);
+      return;
+    }
 
-      context.context_stack.pop();
-      cout << "KTHXBYE" << endl;
-      context.output("movl $1, %eax", line);
-      context.output("movl $0, %ebx");
-      context.output("int $0x80");
+    struct timespec start, end;
+    double outer_children = context.child_seconds;
+    context.child_seconds = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    func(node, context);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    HookStats &stats = context.hook_stats[ type_names[node->type] ];
+    stats.calls += 1;
+    stats.seconds += elapsed;
+    stats.self_seconds += elapsed - context.child_seconds;
+    context.child_seconds = outer_children + elapsed;
+  }
+
+  /*!
+   * \brief Find a variable's pointer on the stack
+   *
+   * \param ctext The variable context the variable is in
+   * \param name The name of the variable
+   * \param context The compiler context
+   * \return The operand for the variable's slot, relative to the current %esp
+   */
+
+  static Operand var_slot(const string &ctext, const string &name, CompilerContext &context)
+  {
+    return mem(context.stack_ptr, context.stack_depth - context.offset[ctext][name]);
+  }
+
+  /*!
+   * \brief Check whether a variable is a scalar
+   *
+   *   A variable that is never indexed (with the "promote" flag set, see
+   * program) is kept in a value_t on the stack instead of in the runtime: its
+   * slot holds the value itself rather than a pointer to a variable_t.
+   */
+
+  static bool is_scalar(const string &name, CompilerContext &context)
+  {
+    return context.flags["promote"] && context.indexed.count(name) == 0;
+  }
+
+  /*!
+   * \brief Pop the stack back down to where it was at some earlier point
+   *
+   * \param depth The stack_depth to return to
+   * \param context The compiler context
+   */
+
+  static void pop_to(int depth, CompilerContext &context)
+  {
+    if (context.stack_depth > depth)
+      context.emit(I_ADDL, imm(context.stack_depth - depth), reg(context.stack_ptr));
+  }
+
+  /*!
+   * \brief Start a block of statements (the body of a loop, a branch, ...)
+   *
+   * \param block The name of the block's context
+   * \param context The compiler context
+   * \return The scope to give back to leave_block
+   */
+
+  static unsigned enter_block(const string &block, CompilerContext &context)
+  {
+    context.mem_stack[block] = context.stack_depth;
+    context.scope_start[block] = context.scope_vars.size();
+    return context.scope_vars.size();
+  }
+
+  /*!
+   * \brief Free the runtime variables declared since the start of a block
+   *
+   * \param block The name of the block's context
+   * \param context The compiler context
+   */
 
+  static void release_vars(const string &block, CompilerContext &context)
+  {
+    unsigned count = 0;
+    for (unsigned i = context.scope_start[block]; i < context.scope_vars.size(); ++i)
+    {
+      if (!is_scalar(context.scope_vars[i], context))
+        ++count;
     }
-    catch (HookError e)
+    if (count == 0)
+      return;
+    context.emit(I_PUSH, imm(count));
+    context.emit(I_CALL, context.symbol("lol_scope_release"));
+    context.emit(I_ADDL, imm(4), reg(context.stack_ptr));
+  }
+
+  /*!
+   * \brief Free the YARNs held by the scalars declared since the start of a block
+   *
+   * This has to be done before their slots are popped.
+   *
+   * \param block The name of the block's context
+   * \param context The compiler context
+   */
+
+  static void free_scalars(const string &block, CompilerContext &context)
+  {
+    string ctext = context.varcontext_stack.top();
+    for (unsigned i = context.scope_start[block]; i < context.scope_vars.size(); ++i)
     {
-      e.called_by(rule,line);
-      throw e;
+      const string &name = context.scope_vars[i];
+      if (!is_scalar(name, context) || context.yarn_vars.count(name) == 0)
+        continue;
+      context.emit(I_LEAL, var_slot(ctext, name, context), reg(context.ret_reg));
+      context.emit(I_PUSH, reg(context.ret_reg));
+      context.emit(I_CALL, context.symbol("lol_yarn_free"), none(), name);
+      context.emit(I_ADDL, imm(4), reg(context.stack_ptr));
     }
   }
 
   /*!
-   * \brief Access an array
+   * \brief End a block of statements
    *
-   * This handles accessing arrays, and expanding them if necessary
-   * Children:
-   *  0. array
-   *  1. expr
-   *   -or-
-   *  0. word
-   * 
-   * \param node The node to traverse
+   * The variables allocated in the block are popped off of the stack (so the
+   * stack is the same no matter how many times the block runs), released in
+   * the runtime (or, for scalars, have their YARNs freed) and forgotten.
+   *
+   * \param block The name of the block's context
+   * \param scope What enter_block returned
    * \param context The compiler context
-   * \return pushes: {S} arr_name, {I} dim#, dim1min, dim1max, ... dimNmin, dimNmax
-   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
    */
 
-  void array(ASTNode *node, CompilerContext &context) 
-  { 
-    string rule = type_names[node->type];
-    unsigned line = node->lineno;
+  static void leave_block(const string &block, unsigned scope, CompilerContext &context)
+  {
     string ctext = context.varcontext_stack.top();
-    try
+    free_scalars(block, context);
+    pop_to(context.mem_stack[block], context);
+    release_vars(block, context);
+    while (context.scope_vars.size() > scope)
     {
-      string varname = "";
-      ASTNode *firstnode = (ASTNode*)(node->nodes[0]);
-      //cout << "Type1: " << type_names[ firstnode->type ] << endl;
-      if (strcmp( type_names[ firstnode->type ], "word") == 0)
-      { // straight-up array
-        char *varname = (char*)((ASTNode*)node->nodes[0])->nodes[0];
-        bool need_registers = true;
-        //cout << "Variable: " << varname << endl;
-        cout << varname << endl;
-        if (context.flags["r_value"] == true)
-        {
-          if (context.variables[ctext].find(varname) == context.variables[ctext].end())
-          {
-            // allocate the new variable
-            context.output("push $1", line); // dimension count
-            context.output("push $" + convert<int,string>(TYPE_IDK)); // type
-            context.output("call varalloc", string(varname)); // allocate var
-            context.output("addl $8, " + context.stack_ptr); // pop params from stack
-            context.output("movl " + context.ret_reg + ", " + context.var_reg); // move return value into the variable register
-            context.output("push $1"); // push new length
-            context.output("push $0"); // push dimension
-            context.output("push " + context.var_reg); // push pointer
-            context.output("call vardimalloc"); // allocate dimension
-            context.output("pop " + context.var_reg); // pop off the arguments (just in case it was clobbered, I guess)
-            context.output("addl $8, " + context.stack_ptr); // pop off the rest of the arguments
-            context.output("movl 12(" + context.var_reg + "), " + context.dim_reg);
-            context.output("push " + context.var_reg, "Store " + string(varname));
-            need_registers = false;
-            context.mem_stack[ctext] -= 4; // allocate the size of a pointer on the stack
-            for (map<string, int>::iterator iter = context.offset[ctext].begin(); iter != context.offset[ctext].end(); ++iter)
-            {
-              iter->second += 4;
-              //cout << "After stack decrement, " << iter->first << " is now at " << iter->second << "(" << context.stack_ptr << ")" << endl;
-            }
-            context.offset[ctext][varname] = 0;
-            //cout << "After stack decrement, " << varname << " is now at " << 0 << "(" << context.stack_ptr << ")" << endl;
+      string name = context.scope_vars.back();
+      context.scope_vars.pop_back();
+      context.offset[ctext].erase(name);
+      context.variables[ctext].erase(name);
+      context.dimensions[ctext].erase(name);
+    }
+  }
 
-            //context.variables[ctext][varname] = varname + convert<unsigned,string>(line);
-            context.variables[ctext][varname] = "IDK";
-            context.dimensions[ctext][varname].push_back(1);
-          }
-        }
-        if (context.variables[ctext].find(varname) == context.variables[ctext].end())
-        {
-          throw HookError("No such variable: " + string(varname));
-        }
-        // Load up the variable as we'll need it
-        if (need_registers)
-        {
-          context.output("movl " + convert<int,string>(context.offset[ctext][varname]) + "(" + context.stack_ptr + "), " + context.var_reg, line);
-          context.output("movl 12(" + context.var_reg + "), " + context.dim_reg, varname);
-          context.output("push $0");
-          context.output("push " + context.dim_reg);
-          context.output("call validx");
-          context.output("addl $8, " + context.stack_ptr);
-          context.output("movl " + context.ret_reg + ", " + context.dim_reg);
-          context.output("movl (" + context.dim_reg + "), " + context.ret_reg);
-        } 
-        // return (REMEMBER: Backwards of what's popped!)
-        context.string_stack.push(varname);
-        for (int i = context.dimensions[ctext][varname].size()-1; i >= 0; --i)
-        {
-          context.int_stack.push( context.dimensions[ctext][varname][i] ); // dimNmax
-          context.int_stack.push( 0 ); // dimNmin
-        }
-        context.int_stack.push( context.dimensions[ctext][varname].size() );
-        //cout << "Done with array branch 1!" << endl;
-      }
-      else
-      { // sub-indexed array
-        // Get the name of the array
-        cout << "SUB INDEXED ARRAY (warning, not debugged!)" << endl;
-        int dims, idxn;
-        vector<int> mindims, maxdims;
-        ASTNode *array = (ASTNode*)node->nodes[0];
-        hook_search( type_names[array->type] )(array,context);
+  /*!
+   * \brief Check which rule generated a node
+   */
 
-        // Get the return value
-        varname = context.string_stack.top(); context.string_stack.pop();
-        idxn = context.int_stack.top();       context.int_stack.pop();
-        dims = context.int_stack.top();       context.int_stack.pop();
-        for (int i = 0; i < dims; ++i)
-        {
-          mindims.push_back( context.int_stack.top() ); context.int_stack.pop();
-          maxdims.push_back( context.int_stack.top() ); context.int_stack.pop();
-        }
+  static bool is_rule(ASTNode *node, const char *rule)
+  {
+    return strcmp(type_names[node->type], rule) == 0;
+  }
+
+  /*!
+   * \brief Check whether an expression is a constant
+   *
+   * \param node The expression
+   * \param value Set to the value of the constant
+   * \return true if it is one
+   */
+
+  static bool constant_value(ASTNode *node, int &value)
+  {
+    if (is_rule(node, "number"))
+    {
+      value = ast_int(node, 0);
+      return true;
+    }
+    if (is_rule(node, "increment_expr"))
+    {
+      if (node->nodecount == 1)
+        return constant_value(ast_child(node, 0), value);
+      value = 1; // the default
+      return true;
+    }
+    return false;
+  }
+
+  /*!
+   * \brief Evaluate both operands of a binary operator
+   *
+   * The left operand is left in %eax.  A constant right operand is not
+   * evaluated at all; it is returned as an immediate instead.
+   *
+   * \param left The left operand
+   * \param right The right operand
+   * \param context The compiler context
+   * \return The right operand (an immediate, or %ecx)
+   */
+
+  static Operand operands(ASTNode *left, ASTNode *right, CompilerContext &context)
+  {
+    int value;
+    if (constant_value(right, value))
+    {
+      run_hook(left, context);
+      return imm(value);
+    }
+    run_hook(right, context);
+    context.emit(I_PUSH, reg(context.ret_reg));
+    run_hook(left, context);
+    context.emit(I_POP, reg(context.cnt_reg));
+    return reg(context.cnt_reg);
+  }
+
+  /*!
+   * \brief Generate the code for a condition as a conditional jump
+   *
+   * \param cond The condexpr node
+   * \param target The label to jump to
+   * \param when Jump if the condition is this (otherwise fall through)
+   * \param context The compiler context
+   */
+
+  static void branch(ASTNode *cond, const string &target, bool when, CompilerContext &context)
+  {
+    context.string_stack.push(target);
+    context.int_stack.push(when);
+    run_hook(cond, context);
+  }
 
-        ASTNode *array_index = (ASTNode*)node->nodes[1];
-        hook_search( type_names[array_index->type] )(array_index,context); // stores in eax
-        context.output("movl " + convert<int,string>(context.offset[ctext][varname]) + "(" + context.stack_ptr + "), " + context.var_reg, line);
-        context.output("movl 12(" + context.var_reg + "), " + context.dim_reg);
-        context.output("push " + context.ret_reg, "expr");
-        context.output("push " + context.dim_reg, varname);
-        context.output("call validx");
-        context.output("addl $4, " + context.stack_ptr);
-        context.output("movl " + context.ret_reg + ", " + context.dim_reg);
-        context.output("movl (" + context.dim_reg + "), " + context.ret_reg);
+  /*!
+   * \brief Find the name of the variable an array expression refers to
+   */
+
+  static const char *root_name(ASTNode *array)
+  {
+    while (!is_rule(ast_child(array, 0), "word"))
+      array = ast_child(array, 0);
+    return ast_text(ast_child(array, 0), 0);
+  }
+
+  /*!
+   * \brief Check whether two array expressions are the same plain variable
+   */
+
+  static bool same_variable(ASTNode *a, ASTNode *b)
+  {
+    return is_rule(a, "array") && is_rule(b, "array") &&
+           is_rule(ast_child(a, 0), "word") && is_rule(ast_child(b, 0), "word") &&
+           strcmp(root_name(a), root_name(b)) == 0;
+  }
+
+  /*!
+   * \brief Write out a node and everything under it, so that two expressions can be compared
+   */
+
+  static void node_key(ASTNode *node, string &key)
+  {
+    key += type_names[node->type];
+    key += '(';
+    for (unsigned i = 0; i < node->nodecount; ++i)
+    {
+      switch (ast_kind(node, i))
+      {
+        case AST_NODE:
+          if (ast_slot(node, i) != 0)
+            node_key(ast_child(node, i), key);
+          break;
+        case AST_CHAR:
+          key += ast_char(node, i);
+          break;
+        case AST_INT:
+          key += std::to_string(ast_int(node, i));
+          break;
+        case AST_TEXT:
+          key += ast_text(node, i);
+          break;
+      }
+      key += ',';
+    }
+    key += ')';
+  }
+
+  /*!
+   * \brief The key of an element (MAH var!!index, ...) in CompilerContext::element_slots
+   */
+
+  static string element_key(ASTNode *array)
+  {
+    string key;
+    node_key(array, key);
+    return key;
+  }
+
+  /*!
+   * \brief Skip the initializer or increment_expr wrapped around an expression
+   */
+
+  static ASTNode *unwrap(ASTNode *node)
+  {
+    if ((is_rule(node, "initializer") || is_rule(node, "increment_expr")) && node->nodecount == 1)
+      return ast_child(node, 0);
+    return node;
+  }
+
+  /*!
+   * \brief Turn a bare word (the status of a DIAF, ...) into an expression
+   *
+   * Numbers and strings are expressions already.  A word gets an array node
+   * of its own, which the caller gives back with free_expr.
+   */
+
+  static ASTNode *as_expr(ASTNode *node)
+  {
+    static unsigned long array_id = 0;
+    if (!is_rule(node, "word"))
+      return node;
+    for (unsigned long i = 0; array_id == 0 && i < type_count; ++i)
+    {
+      if (strcmp(type_names[i], "array") == 0)
+        array_id = i;
+    }
+    ASTNode *array = create_ast_node(array_id, node->lineno, 0);
+    append_leaf(array, node);
+    return array;
+  }
+
+  /*!
+   * \brief Give back the node as_expr made for a word (if it made one)
+   *
+   * The word itself stays in the tree it came from.
+   */
+
+  static void free_expr(ASTNode *expr, ASTNode *node)
+  {
+    if (expr != node)
+      free_ast_node(expr);
+  }
+
+  /*!
+   * \brief Check whether an expression is always a YARN
+   *
+   * Literals are, and adding anything to a YARN makes one.  A variable never
+   * is for sure (see may_be_yarn).
+   */
+
+  static bool is_yarn(ASTNode *node, CompilerContext &context)
+  {
+    node = unwrap(node);
+    if (is_rule(node, "string"))
+      return true;
+    if (is_rule(node, "expr") && node->nodecount == 3 && ast_char(node, 0) == '+')
+      return is_yarn(ast_child(node, 1), context) || is_yarn(ast_child(node, 2), context);
+    return false;
+  }
+
+  /*!
+   * \brief Check whether an expression can be a YARN when the program runs
+   *
+   * A variable in yarn_vars (see find_yarns) may hold either a YARN or a
+   * NUMBR, so an expression that reads one is only known once it is run: the
+   * runtime's lol_value_* functions look at the tag.
+   */
+
+  static bool may_be_yarn(ASTNode *node, CompilerContext &context)
+  {
+    node = unwrap(node);
+    if (is_rule(node, "array"))
+      return context.yarn_vars.count(root_name(node)) != 0;
+    if (is_rule(node, "expr") && node->nodecount == 3 && ast_char(node, 0) == '+')
+      return may_be_yarn(ast_child(node, 1), context) || may_be_yarn(ast_child(node, 2), context);
+    return is_yarn(node, context);
+  }
+
+  /*!
+   * \brief Add the variables that a YARN is stored in under a node to yarn_vars
+   */
+
+  static void find_yarn_stores(ASTNode *node, CompilerContext &context)
+  {
+    if ((is_rule(node, "assignment") || is_rule(node, "declaration")) && may_be_yarn(ast_child(node, 1), context))
+      context.yarn_vars.insert(root_name(ast_child(node, 0)));
+    else if (is_rule(node, "self_assignment") && ast_char(node, 0) == '+' && may_be_yarn(ast_child(node, 2), context))
+      context.yarn_vars.insert(root_name(ast_child(node, 1)));
+    else if (is_rule(node, "input"))
+      context.yarn_vars.insert(root_name(ast_child(node, 1)));
+    for (unsigned i = 0; i < node->nodecount; ++i)
+    {
+      if (ast_kind(node, i) == AST_NODE && ast_slot(node, i) != 0)
+        find_yarn_stores(ast_child(node, i), context);
+    }
+  }
+
+  /*!
+   * \brief Find the variables that a YARN can reach under a node (see may_be_yarn)
+   *
+   *   This is done before any code is made for the node, so an assignment in
+   * a branch that is not taken, or further down a loop body, counts as much
+   * as one that comes first.  Variables are only known by name here, so one
+   * that shares its name with such a variable in another block is counted too.
+   */
+
+  static void find_yarns(ASTNode *node, CompilerContext &context)
+  {
+    size_t found;
+    do
+    { // again until nothing is added (X R Y can come before Y R "...")
+      found = context.yarn_vars.size();
+      find_yarn_stores(node, context);
+    } while (context.yarn_vars.size() != found);
+  }
+
+  /*!
+   * \brief Free the YARN in a temporary on the stack
+   *
+   * \param depth The stack_depth just after the temporary was reserved
+   * \param context The compiler context
+   */
+
+  static void free_yarn(int depth, CompilerContext &context)
+  {
+    context.emit(I_LEAL, mem(context.stack_ptr, context.stack_depth - depth), reg(context.ret_reg));
+    context.emit(I_PUSH, reg(context.ret_reg));
+    context.emit(I_CALL, context.symbol("lol_yarn_free"));
+    context.emit(I_ADDL, imm(4), reg(context.stack_ptr));
+  }
+
+  /*!
+   * \brief Reserve an empty value_t on the stack (for a YARN being built)
+   *
+   * \return The stack_depth just after it (its address is then %esp)
+   */
+
+  static int reserve_yarn(CompilerContext &context, unsigned line)
+  {
+    context.emit(I_SUBL, imm(sizeof(value_t)), reg(context.stack_ptr), line);
+    context.emit(I_MOVL, imm(0), mem(context.stack_ptr, 4)); // tag: no YARN yet
+    return context.stack_depth;
+  }
+
+  static bool yarn_value(ASTNode *node, CompilerContext &context);
+
+  /*!
+   * \brief Put two YARNs together
+   *
+   * The result is built in a temporary left on top of the stack (whoever uses
+   * it pops it); any temporaries the operands needed are freed and popped.
+   * Unless one of them is always a YARN, lol_value_add decides when the
+   * program runs whether they are put together or added up.
+   *
+   * \param node The expr node
+   * \param context The compiler context
+   */
+
+  static void concat(ASTNode *node, CompilerContext &context)
+  {
+    unsigned line = node->lineno;
+    int result = reserve_yarn(context, line);
+    bool right_temp = yarn_value(ast_child(node, 2), context);
+    int right = context.stack_depth;
+    context.emit(I_PUSH, reg(context.ret_reg));
+    bool left_temp = yarn_value(ast_child(node, 1), context);
+    int left = context.stack_depth;
+    if (left_temp) // the arguments have to be next to each other
+      context.emit(I_PUSH, mem(context.stack_ptr, context.stack_depth - (right + 4)));
+    context.emit(I_PUSH, reg(context.ret_reg));
+    context.emit(I_LEAL, mem(context.stack_ptr, context.stack_depth - result), reg(context.ret_reg));
+    context.emit(I_PUSH, reg(context.ret_reg));
+    context.emit(I_CALL, context.symbol(is_yarn(node, context) ? "lol_yarn_concat" : "lol_value_add"), none(), line);
+    pop_to(left, context);
+    if (left_temp)
+      free_yarn(left, context);
+    pop_to(right, context);
+    if (right_temp)
+      free_yarn(right, context);
+    pop_to(result, context);
+    context.emit(I_MOVL, reg(context.stack_ptr), reg(context.ret_reg));
+  }
+
+  /*!
+   * \brief Evaluate an expression as a YARN
+   *
+   * Leaves the address of a value_t holding the YARN in ret_reg.  A NUMBR is
+   * put in a value_t of its own, which the runtime's YARN functions read as
+   * its digits (and the lol_value_* functions as a NUMBR).
+   *
+   * \param node The expression
+   * \param context The compiler context
+   * \return true if the YARN is in a temporary left on top of the stack (to be
+   * freed and popped by the caller), false if it belongs to a variable or is
+   * a constant
+   */
+
+  static bool yarn_value(ASTNode *node, CompilerContext &context)
+  {
+    node = unwrap(node);
+    if (is_rule(node, "expr") && may_be_yarn(node, context))
+    {
+      concat(node, context);
+      return true;
+    }
+    if (is_rule(node, "array") && may_be_yarn(node, context))
+    {
+      context.flags["value"] = true; // the value_t, not the NUMBR in it (see array)
+      run_hook(node, context);
+      context.emit(I_MOVL, reg(context.dim_reg), reg(context.ret_reg));
+      return false;
+    }
+    if (is_rule(node, "string"))
+    {
+      run_hook(node, context);
+      return false;
+    }
+    // A NUMBR
+    run_hook(node, context);
+    context.emit(I_PUSH, imm(0), none(), node->lineno); // not a YARN
+    context.emit(I_PUSH, reg(context.ret_reg));
+    context.emit(I_MOVL, reg(context.stack_ptr), reg(context.ret_reg));
+    return true;
+  }
+
+  /*!
+   * \brief Quote text for .ascii
+   */
+
+  static string asm_quote(const string &text)
+  {
+    string quoted = "\"";
+    for (unsigned i = 0; i < text.size(); ++i)
+    {
+      unsigned char c = text[i];
+      if (c == '"' || c == '\\')
+      {
+        quoted += '\\';
+        quoted += c;
+      }
+      else if (c < ' ' || c >= 0x7f)
+      {
+        char octal[8];
+        snprintf(octal, sizeof(octal), "\\%03o", c);
+        quoted += octal;
+      }
+      else
+      {
+        quoted += c;
+      }
+    }
+    return quoted + "\"";
+  }
+
+  /*!
+   * \brief Find the variables that are indexed (MAH var!!...) anywhere under a node
+   */
+
+  static void find_indexed(ASTNode *node, CompilerContext &context)
+  {
+    if (is_rule(node, "array") && !is_rule(ast_child(node, 0), "word"))
+      context.indexed.insert(root_name(node));
+    for (unsigned i = 0; i < node->nodecount; ++i)
+    {
+      if (ast_kind(node, i) == AST_NODE && ast_slot(node, i) != 0)
+        find_indexed(ast_child(node, i), context);
+    }
+  }
+
+  /*!
+   * \brief Start the program (see program)
+   */
+
+  static void program_start(unsigned line, CompilerContext &context)
+  {
+    context.header(".section .data");
+    if (context.debug)
+      context.output(".file 1 " + asm_quote(context.filename));
+    context.output(".section .text");
+    context.output(".globl main");
+    context.emit(I_LABEL, context.symbol("main"), none(), line);
+    if (context.debug)
+      context.output(".cfi_startproc");
+    if (context.flags["profile"])
+    {
+      context.header("lolprof_file:");
+      context.header(".asciz " + asm_quote(context.filename));
+      context.emit(I_PUSH, context.address("lolprof_file"), none(), "profile");
+      context.emit(I_CALL, context.symbol("lolprof_init"));
+      context.emit(I_ADDL, imm(4), reg(context.stack_ptr));
+    }
+    context.context_stack.push("program");
+    context.varcontext_stack.push("global");
+  }
+
+  /*!
+   * \brief End the program (see program)
+   */
+
+  static void program_finish(unsigned line, CompilerContext &context)
+  {
+    context.context_stack.pop();
+    context.emit(I_PUSH, imm(0), none(), line);
+    context.emit(I_CALL, context.symbol("lol_exit")); // flushes VISIBLE (and writes the profile)
+    if (context.debug)
+      context.output(".cfi_endproc");
+  }
+
+  /*!
+   * \brief Outer program block
+   *
+   * This handles the generalized program set-up and destruction.  Unless
+   * the "no_promote" flag is set, the whole program is looked over first so
+   * that the variables it never indexes can be kept as scalars (see
+   * is_scalar).  It is always looked over for the variables that a YARN can
+   * reach (see find_yarns).
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return The standard hook return
+   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   */
+
+  void program(ASTNode *node, CompilerContext &context) 
+  { 
+    string rule = type_names[node->type];
+    unsigned line = node->lineno;
+    try
+    {
+      if (!context.flags["no_promote"])
+      { // the variables that are never indexed become scalars
+        find_indexed(node, context);
+        context.flags["promote"] = true;
+      }
+      find_yarns(node, context);
+      program_start(line, context);
+     
+      if (!node->terminal)
+      {
+        for (unsigned i = 0; i < node->nodecount; ++i)
+        {
+          ASTNode *child = ast_child(node, i);
+          run_hook(child, context);
+        }
+      }
+
+      program_finish(line, context);
+    }
+    catch (HookError e)
+    {
+      e.called_by(rule,line);
+      throw e;
+    }
+  }
+
+  /*!
+   * \brief Access an array
+   *
+   * This handles accessing arrays, and expanding them if necessary.  Every
+   * element is found by lol_bukkit_at (or lol_bukkit_sub, for an element of
+   * an element) in the runtime, which knows whether the variable is held
+   * dense or sparse; the element's address is left in dim_reg and its value
+   * in ret_reg.  An l_value ("r_value" flag) makes room for the element.
+   * A scalar (see is_scalar) is read straight from its slot instead, and an
+   * element of the variable a loop has pinned (see pin_array) is read from
+   * the dense block without a call when it is in there.  The element an
+   * assignment is storing to is read through the address the assignment
+   * kept (see assignment).  An element of a variable that may hold a YARN
+   * (see may_be_yarn) has its NUMBR checked for by lol_value_numbr, unless
+   * the "value" flag asks for just its address.
+   * Children:
+   *  0. array
+   *  1. expr
+   *   -or-
+   *  0. word
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return pushes: {S} arr_name, {I} dim#, dim1min, dim1max, ... dimNmin, dimNmax
+   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   */
+
+  void array(ASTNode *node, CompilerContext &context) 
+  { 
+    string rule = type_names[node->type];
+    unsigned line = node->lineno;
+    string ctext = context.varcontext_stack.top();
+    bool store = context.flags["r_value"];
+    bool subscript = context.flags["subscript"]; // the outer array only needs the element's address
+    context.flags["subscript"] = false;
+    bool value = context.flags["value"]; // (see yarn_value)
+    context.flags["value"] = false;
+    int mode = (store ? LOL_AT_STORE : 0) | (subscript ? LOL_AT_BUKKIT : 0);
+    try
+    {
+      string varname = "";
+      ASTNode *firstnode = ast_child(node, 0);
+      //cout << "Type1: " << type_names[ firstnode->type ] << endl;
+      if (strcmp( type_names[ firstnode->type ], "word") == 0)
+      { // straight-up array
+        const char *varname = ast_text(ast_child(node, 0), 0);
+        bool need_registers = true;
+        if (context.flags["r_value"] == true)
+        {
+          if (context.variables[ctext].find(varname) == context.variables[ctext].end() && is_scalar(varname, context))
+          {
+            // a scalar is just a value_t on the stack
+            context.emit(I_PUSH, imm(0), none(), line); // not a YARN
+            context.emit(I_PUSH, imm(0), none(), "Store " + string(varname));
+            context.emit(I_MOVL, reg(context.stack_ptr), reg(context.dim_reg));
+            need_registers = false;
+            context.offset[ctext][varname] = context.stack_depth; // where the value is (see var_slot)
+            context.scope_vars.push_back(varname);
+
+            context.variables[ctext][varname] = "IDK";
+            context.dimensions[ctext][varname].push_back(1);
+          }
+          else if (context.variables[ctext].find(varname) == context.variables[ctext].end())
+          {
+            // allocate the new variable
+            context.emit(I_PUSH, imm(1), none(), line); // dimension count
+            context.emit(I_PUSH, imm(TYPE_IDK)); // type
+            context.emit(I_CALL, context.symbol("varalloc"), none(), varname); // allocate var
+            context.emit(I_ADDL, imm(8), reg(context.stack_ptr)); // pop params from stack
+            context.emit(I_MOVL, reg(context.ret_reg), reg(context.var_reg)); // move return value into the variable register
+            context.emit(I_PUSH, imm(1)); // push new length
+            context.emit(I_PUSH, imm(0)); // push dimension
+            context.emit(I_PUSH, reg(context.var_reg)); // push pointer
+            context.emit(I_CALL, context.symbol("vardimalloc")); // allocate dimension
+            context.emit(I_POP, reg(context.var_reg)); // pop off the arguments (just in case it was clobbered, I guess)
+            context.emit(I_ADDL, imm(8), reg(context.stack_ptr)); // pop off the rest of the arguments
+            context.emit(I_MOVL, mem(context.var_reg, 12), reg(context.dim_reg));
+            context.emit(I_PUSH, reg(context.var_reg), none(), "Store " + string(varname));
+            need_registers = false;
+            context.offset[ctext][varname] = context.stack_depth; // where the pointer is (see var_slot)
+            context.scope_vars.push_back(varname);
+
+            context.variables[ctext][varname] = "IDK";
+            context.dimensions[ctext][varname].push_back(1);
+          }
+        }
+        if (context.variables[ctext].find(varname) == context.variables[ctext].end())
+        {
+          throw HookError("No such variable: " + string(varname));
+        }
+        // Load up the variable as we'll need it
+        if (need_registers && !subscript && is_scalar(varname, context))
+        {
+          Operand slot = var_slot(ctext, varname, context);
+          context.emit(I_MOVL, slot, reg(context.ret_reg), line);
+          context.emit(I_LEAL, slot, reg(context.dim_reg), varname);
+        }
+        else if (need_registers && !subscript)
+        {
+          context.emit(I_MOVL, var_slot(ctext, varname, context), reg(context.var_reg), line);
+          context.emit(I_PUSH, imm(mode));
+          context.emit(I_PUSH, imm(0));
+          context.emit(I_PUSH, reg(context.var_reg), none(), varname);
+          context.emit(I_CALL, context.symbol("lol_bukkit_at"));
+          context.emit(I_ADDL, imm(12), reg(context.stack_ptr));
+          context.emit(I_MOVL, reg(context.ret_reg), reg(context.dim_reg));
+          context.emit(I_MOVL, mem(context.dim_reg), reg(context.ret_reg));
+        } 
+        // return (REMEMBER: Backwards of what's popped!)
+        context.string_stack.push(varname);
+        for (int i = context.dimensions[ctext][varname].size()-1; i >= 0; --i)
+        {
+          context.int_stack.push( context.dimensions[ctext][varname][i] ); // dimNmax
+          context.int_stack.push( 0 ); // dimNmin
+        }
+        context.int_stack.push( context.dimensions[ctext][varname].size() );
+        //cout << "Done with array branch 1!" << endl;
+      }
+      else if (!store && !subscript && !context.element_slots.empty() &&
+               context.element_slots.count(element_key(node)) != 0)
+      { // the assignment this is in has found the element already
+        string key = element_key(node);
+        varname = root_name(node);
+        context.emit(I_MOVL, mem(context.stack_ptr, context.stack_depth - context.element_slots[key]), reg(context.dim_reg), line);
+        context.emit(I_MOVL, mem(context.dim_reg), reg(context.ret_reg), varname);
+
+        context.string_stack.push(varname);
+        for (int i = context.dimensions[ctext][varname].size()-1; i >= 0; --i)
+        {
+          context.int_stack.push( context.dimensions[ctext][varname][i] ); // dimNmax
+          context.int_stack.push( 0 ); // dimNmin
+        }
+        context.int_stack.push( context.dimensions[ctext][varname].size() );
+      }
+      else
+      { // sub-indexed array
+        // Get the name of the array
+        int dims;
+        vector<int> mindims, maxdims;
+        ASTNode *array = ast_child(node, 0);
+        bool nested = array->nodecount == 2; // MAH MAH var!!i!!index
+        context.flags["subscript"] = true;
+        run_hook(array, context); // for nested, the outer element's address in dim_reg
+        context.flags["subscript"] = false;
+
+        // Get the return value
+        varname = context.string_stack.top(); context.string_stack.pop();
+        dims = context.int_stack.top();       context.int_stack.pop();
+        for (int i = 0; i < dims; ++i)
+        {
+          mindims.push_back( context.int_stack.top() ); context.int_stack.pop();
+          maxdims.push_back( context.int_stack.top() ); context.int_stack.pop();
+        }
+
+        ASTNode *array_index = ast_child(node, 1);
+        if (nested)
+          context.emit(I_PUSH, reg(context.dim_reg));
+        context.flags["r_value"] = false; // the index is only read
+        run_hook(array_index, context); // stores in eax
+        context.flags["r_value"] = store;
+        string done;
+        if (!nested && !store && varname == context.pinned)
+        { // the dense block is in ptr_reg and its length in frame_ptr (see pin_array)
+          string slow = ".Lslow" + std::to_string(context.counter);
+          done = ".Lfound" + std::to_string(context.counter++);
+          context.emit(I_CMPL, reg(context.frame_ptr), reg(context.ret_reg), line);
+          context.emit(I_JAE, context.symbol(slow));
+          context.emit(I_LEAL, mem(context.ptr_reg, context.ret_reg, 8), reg(context.dim_reg), varname);
+          context.emit(I_JMP, context.symbol(done));
+          context.emit(I_LABEL, context.symbol(slow));
+        }
+        if (nested)
+          context.emit(I_POP, reg(context.dim_reg));
+        else
+          context.emit(I_MOVL, var_slot(ctext, varname, context), reg(context.var_reg), line);
+        context.emit(I_PUSH, imm(mode));
+        context.emit(I_PUSH, reg(context.ret_reg), none(), "expr");
+        if (nested)
+        {
+          context.emit(I_PUSH, reg(context.dim_reg));
+          context.emit(I_CALL, context.symbol("lol_bukkit_sub"), none(), line);
+        }
+        else
+        {
+          context.emit(I_PUSH, reg(context.var_reg), none(), varname);
+          context.emit(I_CALL, context.symbol("lol_bukkit_at"));
+        }
+        context.emit(I_ADDL, imm(12), reg(context.stack_ptr));
+        context.emit(I_MOVL, reg(context.ret_reg), reg(context.dim_reg));
+        if (!done.empty())
+          context.emit(I_LABEL, context.symbol(done));
+        context.emit(I_MOVL, mem(context.dim_reg), reg(context.ret_reg));
+
+        // return the same as the array that was indexed
+        context.string_stack.push(varname);
+        for (int i = dims-1; i >= 0; --i)
+        {
+          context.int_stack.push( maxdims[i] );
+          context.int_stack.push( mindims[i] );
+        }
+        context.int_stack.push( dims );
+      }
+      if (!store && !subscript && !value && context.yarn_vars.count(root_name(node)) != 0)
+      { // it may be a YARN
+        context.emit(I_PUSH, reg(context.dim_reg));
+        context.emit(I_CALL, context.symbol("lol_value_numbr"));
+        context.emit(I_ADDL, imm(4), reg(context.stack_ptr));
+      }
+    }
+    catch (HookError e)
+    {
+      e.called_by(rule,line);
+      throw e;
+    }
+  }
+
+  /*!
+   * \brief Run an assignment
+   *
+   * This handles assignment of variables (and declaration as well).  The
+   * address of the l_value is kept on the stack while the r_value is
+   * evaluated into ret_reg, and an element of the r_value that is the same
+   * as the l_value (MAH A!!I R UP MAH A!!I AN 1, and so UPZ MAH A!!I!!) is
+   * read through it instead of being looked up again.  A variable that may
+   * hold a YARN (see find_yarns) lets go of it before a NUMBR is stored.  One
+   * declared without a value starts out as an empty YARN, which only code
+   * that looks at the tag (for a variable in yarn_vars) ever tells from a 0.
+   * Children:
+   *  0. l_value
+   *  1. r_value
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return The standard hook return
+   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   */
+
+  void assignment(ASTNode *node, CompilerContext &context) 
+  { 
+    string rule = type_names[node->type];
+    unsigned line = node->lineno;
+    try
+    {
+      ASTNode *l_value = ast_child(node, 0);
+      ASTNode *r_value = ast_child(node, 1);
+      const char *name = root_name(l_value);
+      bool either = context.yarn_vars.count(name) != 0;
+      bool fresh = context.variables[context.varcontext_stack.top()].count(name) == 0;
+
+      context.flags["r_value"] = true;
+      run_hook(l_value, context); // address in dim_reg
+      context.flags["r_value"] = false;
+      if (is_rule(r_value, "initializer") && r_value->nodecount == 0)
+      { // declared without a value
+        if (fresh)
+          context.emit(I_MOVL, imm(int(unsigned(YARN_INLINE) << 24)), mem(context.dim_reg, 4)); // an empty YARN
+        return;
+      }
+
+      int depth = context.stack_depth;
+      context.emit(I_PUSH, reg(context.dim_reg));
+      string key = is_rule(ast_child(l_value, 0), "word") ? "" : element_key(l_value);
+      if (!key.empty())
+        context.element_slots[key] = context.stack_depth; // for the r_value to read it from
+      if (may_be_yarn(r_value, context))
+      {
+        int slot = context.stack_depth;
+        const char *store = "lol_yarn_copy";
+        bool append = false;
+        ASTNode *value = unwrap(r_value);
+        if (is_rule(value, "expr") && ast_char(value, 0) == '+' && same_variable(l_value, ast_child(value, 1)))
+        { // X R UP X AN ...: add to the end of it where it is
+          value = ast_child(value, 2);
+          store = is_yarn(value, context) ? "lol_yarn_append" : "lol_value_append";
+          append = true;
+        }
+        bool temp = yarn_value(value, context);
+        context.element_slots.erase(key);
+        int src = context.stack_depth;
+        if (temp && !append)
+          store = "lol_yarn_move";
+        context.emit(I_PUSH, reg(context.ret_reg));
+        context.emit(I_PUSH, mem(context.stack_ptr, context.stack_depth - slot));
+        context.emit(I_CALL, context.symbol(store), none(), line);
+        pop_to(src, context);
+        if (temp && append)
+          free_yarn(src, context);
+        pop_to(depth, context);
+        return;
+      }
+
+      context.flags["l_value"] = true;
+      run_hook(r_value, context); // value in ret_reg
+      context.flags["l_value"] = false;
+      context.element_slots.erase(key);
+      context.emit(I_POP, reg(context.cnt_reg));
+      if (either)
+      { // let go of its text first
+        context.emit(I_PUSH, reg(context.ret_reg));
+        context.emit(I_PUSH, reg(context.cnt_reg));
+        context.emit(I_CALL, context.symbol("lol_yarn_free"));
+        context.emit(I_POP, reg(context.cnt_reg));
+        context.emit(I_POP, reg(context.ret_reg));
+      }
+      context.emit(I_MOVL, reg(context.ret_reg), mem(context.cnt_reg), line);
+      context.emit(I_MOVL, imm(0), mem(context.cnt_reg, 4)); // not a YARN
+    }
+    catch (HookError e)
+    {
+      e.called_by(rule,line);
+      throw e;
+    }
+  }
+
+  /*!
+   * \brief Break out of a loop
+   *
+   * This pops whatever the loop body has put on the stack, releases the
+   * variables it has declared so far and jumps past the end of the innermost
+   * loop
+   * Children:
+   *  - none -
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return The standard hook return
+   * \throw HookError if there is no enclosing loop* context
+   */
+
+  void brk(ASTNode *node, CompilerContext &context) 
+  { 
+    string rule = type_names[node->type];
+    unsigned line = node->lineno;
+    string ctext;
+    { // Find the top-most context with loop in it
+      stack<string> temp;
+      while (context.context_stack.empty() == false)
+      {
+        if (context.context_stack.top().find("loop") == 0) // loop context
+          break;
+        temp.push( context.context_stack.top() );
+        context.context_stack.pop();
+      }
+      if (context.context_stack.empty())
+        throw HookError("BREAK found outside of loop!", rule, line);
+      else
+        ctext = context.context_stack.top();
+      while (temp.empty() == false)
+      {
+        context.context_stack.push( temp.top() );
+        temp.pop();
+      }
+    }
+
+    // Drop whatever the loop body has on the stack and leave
+    int depth = context.stack_depth;
+    free_scalars(ctext, context);
+    pop_to(context.mem_stack[ctext], context);
+    release_vars(ctext, context);
+    context.emit(I_JMP, context.symbol(".L" + ctext + "_end"), none(), line);
+    context.stack_depth = depth; // for the rest of the block (if any)
+  }
+
+  /*!
+   * \brief Evaluate a conditional
+   *
+   * This handles the conditional statements.  The condition jumps straight
+   * to the else-statements (or past the end) when it is false.
+   * Children:
+   *  0. condition
+   *  1. then-statements
+   *  2. (optionaal) else-statements
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return The standard hook return
+   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   */
+
+  void conditional(ASTNode *node, CompilerContext &context) 
+  { 
+    string rule = type_names[node->type];
+    unsigned line = node->lineno;
+    string ctext = "cond" + std::to_string(context.counter++);
+    try
+    {
+      ASTNode *cond = ast_child(node, 0);
+      ASTNode *tbranch = ast_child(node, 1);
+      ASTNode *ebranch = (node->nodecount == 3) ? ast_child(node, 2) : NULL;
+      string else_label = ".L" + ctext + "_else";
+      string end_label = ".L" + ctext + "_end";
+      unsigned scope;
+
+      context.context_stack.push(ctext);
+      branch(cond, (node->nodecount == 3) ? else_label : end_label, false, context);
+      context.context_stack.pop();
+
+      context.context_stack.push(ctext+"then");
+      scope = enter_block(ctext+"then", context);
+      run_hook(tbranch, context);
+      leave_block(ctext+"then", scope, context);
+      context.context_stack.pop();
+
+      if (node->nodecount == 3)
+      {
+        context.emit(I_JMP, context.symbol(end_label));
+        context.emit(I_LABEL, context.symbol(else_label), none(), ebranch->lineno);
+        context.context_stack.push(ctext+"else");
+        scope = enter_block(ctext+"else", context);
+        run_hook(ebranch, context);
+        leave_block(ctext+"else", scope, context);
+        context.context_stack.pop();
+      }
+      context.emit(I_LABEL, context.symbol(end_label));
+    }
+    catch (HookError e)
+    {
+      e.called_by(rule,line);
+      throw e;
+    }
+  }
+
+  /*!
+   * \brief Evaluate a conditional expression
+   *
+   * This handles the conditional expressions.  They are compiled as jumps
+   * and no boolean value is ever computed: AND and OR skip their right side
+   * when the left side decides the result, NOT swaps the sense of the jump
+   * and comparisons become a cmpl and a conditional jump.
+   * Children:
+   *  0. boolean
+   *   -or-
+   *  0. unary op
+   *  1. conditional expression
+   *   -or-
+   *  0. binary op
+   *  1. conditional expression
+   *  2. conditional expression
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return pops: {S} the label to jump to, {I} whether to jump when the condition is true or false (see branch)
+   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   */
+
+  void condexpr(ASTNode *node, CompilerContext &context) 
+  { 
+    string rule = type_names[node->type];
+    unsigned line = node->lineno;
+    string target = context.string_stack.top(); context.string_stack.pop();
+    bool when = context.int_stack.top();        context.int_stack.pop();
+    try
+    {
+      if (node->nodecount == 1) // WIN or FAIL
+      {
+        if ((ast_int(node, 0) == 1) == when)
+          context.emit(I_JMP, context.symbol(target), none(), line);
+        return;
+      }
+
+      char op = ast_char(node, 0);
+      ASTNode *c1 = ast_child(node, 1);
+      ASTNode *c2 = ast_child(node, 2);
+      string skip = ".Lbool" + std::to_string(context.counter++);
+      switch (op)
+      {
+        case '!':
+          branch(c1, target, !when, context);
+          break;
+        case '&':
+          if (!when) // either one being false is enough
+          {
+            branch(c1, target, false, context);
+            branch(c2, target, false, context);
+          }
+          else
+          {
+            branch(c1, skip, false, context);
+            branch(c2, target, true, context);
+            context.emit(I_LABEL, context.symbol(skip));
+          }
+          break;
+        case '|':
+          if (when) // either one being true is enough
+          {
+            branch(c1, target, true, context);
+            branch(c2, target, true, context);
+          }
+          else
+          {
+            branch(c1, skip, true, context);
+            branch(c2, target, false, context);
+            context.emit(I_LABEL, context.symbol(skip));
+          }
+          break;
+        case '^':
+        { // Both sides are needed
+          if (c2->nodecount == 1 || strchr("<>=", ast_char(c2, 0)) != NULL)
+          { // a single comparison: test it on each path
+            string done = skip + "_done";
+            branch(c1, skip, true, context);
+            branch(c2, target, when, context);
+            context.emit(I_JMP, context.symbol(done));
+            context.emit(I_LABEL, context.symbol(skip));
+            branch(c2, target, !when, context);
+            context.emit(I_LABEL, context.symbol(done));
+            break;
+          }
+          // otherwise keep the left one on the stack (nested XORs would
+          // double in size at every level) and flip it if the right one holds
+          string flip = skip + "_flip";
+          context.emit(I_PUSH, imm(0), none(), line);
+          branch(c1, skip, false, context);
+          context.emit(I_MOVL, imm(1), mem(context.stack_ptr));
+          context.emit(I_LABEL, context.symbol(skip));
+          branch(c2, flip, false, context);
+          context.emit(I_XORL, imm(1), mem(context.stack_ptr));
+          context.emit(I_LABEL, context.symbol(flip));
+          context.emit(I_POP, reg(context.cnt_reg));
+          context.emit(I_TESTL, reg(context.cnt_reg), reg(context.cnt_reg));
+          context.emit(when ? I_JNE : I_JE, context.symbol(target));
+          break;
+        }
+        case '>':
+        case '<':
+        case '=':
+        {
+          static const Opcode jump_true[] = { I_JG, I_JL, I_JE };
+          static const Opcode jump_false[] = { I_JLE, I_JGE, I_JNE };
+          int which = (op == '>') ? 0 : (op == '<') ? 1 : 2;
+          if (may_be_yarn(c1, context) || may_be_yarn(c2, context))
+          { // compare the text (or, if neither is always a YARN, let the runtime see), then compare the result with 0
+            bool text = is_yarn(c1, context) || is_yarn(c2, context);
+            int depth = context.stack_depth;
+            bool right_temp = yarn_value(c2, context);
+            int right = context.stack_depth;
+            context.emit(I_PUSH, reg(context.ret_reg));
+            bool left_temp = yarn_value(c1, context);
+            int left = context.stack_depth;
+            if (left_temp) // the arguments have to be next to each other
+              context.emit(I_PUSH, mem(context.stack_ptr, context.stack_depth - (right + 4)));
+            context.emit(I_PUSH, reg(context.ret_reg));
+            context.emit(I_CALL, context.symbol(text ? "lol_yarn_cmp" : "lol_value_cmp"), none(), line);
+            pop_to(left, context);
+            if (left_temp || right_temp)
+            {
+              context.emit(I_MOVL, reg(context.ret_reg), reg(context.var_reg));
+              if (left_temp)
+                free_yarn(left, context);
+              pop_to(right, context);
+              if (right_temp)
+                free_yarn(right, context);
+              context.emit(I_MOVL, reg(context.var_reg), reg(context.ret_reg));
+            }
+            pop_to(depth, context);
+            context.emit(I_CMPL, imm(0), reg(context.ret_reg));
+          }
+          else
+          {
+            Operand right = operands(c1, c2, context);
+            context.emit(I_CMPL, right, reg(context.ret_reg), line);
+          }
+          context.emit(when ? jump_true[which] : jump_false[which], context.symbol(target));
+          break;
+        }
+        default:
+          throw HookError(string("Unknown condition operator: ") + op, rule, line);
+      }
+    }
+    catch (HookError e)
+    {
+      e.called_by(rule,line);
+      throw e;
+    }
+  }
+
+
+  /*!
+   * \brief Evaluate a string constant
+   *
+   * This loads the address of the YARN into ret_reg.  Each different string
+   * is put in the data section once, as a value_t: inline if it is short
+   * enough, or pointing to a constant yarn_block_t if not.
+   * Children:
+   *  0. text
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return The standard hook return
+   */
+
+  void yarn(ASTNode *node, CompilerContext &context) 
+  { 
+    unsigned line = node->lineno;
+    string text = ast_text(node, 0);
+    string &label = context.string_constants[text];
+    if (label.empty())
+    {
+      label = ".Lyarn" + std::to_string(context.counter++);
+      if (text.size() <= YARN_INLINE_MAX)
+      {
+        context.header_raw("  .balign 4\n" + label + ":\n");
+        if (!text.empty())
+          context.header_raw("  .ascii " + asm_quote(text) + "\n");
+        if (text.size() < YARN_INLINE_MAX)
+          context.header_raw("  .zero " + std::to_string(YARN_INLINE_MAX - text.size()) + "\n");
+        context.header_raw("  .byte " + std::to_string(YARN_INLINE | text.size()) + "\n");
+      }
+      else
+      {
+        context.header_raw("  .balign 4\n" + label + "_block:\n");
+        context.header_raw("  .long " + std::to_string(text.size()) + ", 0\n");
+        context.header_raw("  .asciz " + asm_quote(text) + "\n");
+        context.header_raw("  .balign 4\n" + label + ":\n");
+        context.header_raw("  .long " + label + "_block\n");
+        context.header_raw("  .byte 0, 0, 0, " + std::to_string(YARN_HEAP) + "\n");
+      }
+    }
+    context.emit(I_MOVL, context.address(label), reg(context.ret_reg), line);
+  }
+
+  /*!
+   * \brief Evaluate a constant
+   *
+   * This loads a number into ret_reg
+   * Children:
+   *  0. value
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return The standard hook return
+   */
+
+  void constant(ASTNode *node, CompilerContext &context) 
+  { 
+    unsigned line = node->lineno;
+    context.emit(I_MOVL, imm(ast_int(node, 0)), reg(context.ret_reg), line);
+  }
+
+  /*!
+   * \brief Multiply ret_reg by a constant
+   *
+   * Small factors are done with shifts and leal (which can multiply by 3, 5
+   * or 9); anything else is left to imull.
+   *
+   * \param factor The constant
+   * \param context The compiler context
+   * \param line The line of the input being compiled
+   */
+
+  static void multiply_by(int factor, CompilerContext &context, unsigned line)
+  {
+    Reg r = context.ret_reg;
+    unsigned u = (factor < 0) ? 0u - (unsigned)factor : (unsigned)factor;
+    int shift = __builtin_ctz(u ? u : 1);
+    unsigned odd = u >> shift;
+
+    if (factor == 0)
+    {
+      context.emit(I_XORL, reg(r), reg(r), line);
+      return;
+    }
+    if (odd == 3 || odd == 5 || odd == 9)
+    { // x*odd = x + x*(odd-1)
+      context.emit(I_LEAL, mem(r, r, odd-1), reg(r), line);
+    }
+    else if (odd != 1 && __builtin_popcount(odd) == 2 && (odd & 1))
+    { // 2^k + 1
+      context.emit(I_MOVL, reg(r), reg(context.cnt_reg), line);
+      context.emit(I_SHLL, imm(__builtin_ctz(odd - 1)), reg(r));
+      context.emit(I_ADDL, reg(context.cnt_reg), reg(r));
+    }
+    else if (odd != 1 && (odd & (odd + 1)) == 0)
+    { // 2^k - 1
+      context.emit(I_MOVL, reg(r), reg(context.cnt_reg), line);
+      context.emit(I_SHLL, imm(__builtin_ctz(odd + 1)), reg(r));
+      context.emit(I_SUBL, reg(context.cnt_reg), reg(r));
+    }
+    else if (odd != 1)
+    {
+      context.emit(I_IMULL, imm(factor), reg(r), line);
+      return;
+    }
+    if (shift > 0)
+      context.emit(I_SHLL, imm(shift), reg(r), line);
+    if (factor < 0)
+      context.emit(I_NEGL, reg(r));
+  }
+
+  /*!
+   * \brief Divide ret_reg by a (non-zero) constant, the same way idivl would
+   *
+   * The quotient is rounded toward zero.  Powers of two are a shift, with the
+   * dividend biased by divisor-1 when it is negative.  Anything else is a
+   * multiply by the divisor's "magic number" (see Hacker's Delight, 10-4)
+   * followed by a shift and a correction for negative quotients.
+   *
+   * \param divisor The constant
+   * \param context The compiler context
+   * \param line The line of the input being compiled
+   */
+
+  static void divide_by(int divisor, CompilerContext &context, unsigned line)
+  {
+    Reg r = context.ret_reg;
+    unsigned ad = (divisor < 0) ? 0u - (unsigned)divisor : (unsigned)divisor;
+
+    if (ad == 1)
+    {
+      if (divisor < 0)
+        context.emit(I_NEGL, reg(r), none(), line);
+      return;
+    }
+    if ((ad & (ad - 1)) == 0)
+    {
+      int k = __builtin_ctz(ad);
+      context.emit(I_MOVL, reg(r), reg(context.val_reg), line);
+      context.emit(I_SARL, imm(31), reg(context.val_reg));
+      context.emit(I_SHRL, imm(32 - k), reg(context.val_reg));
+      context.emit(I_ADDL, reg(context.val_reg), reg(r));
+      context.emit(I_SARL, imm(k), reg(r));
+      if (divisor < 0)
+        context.emit(I_NEGL, reg(r));
+      return;
+    }
+
+    // The magic number and shift
+    const unsigned two31 = 0x80000000u;
+    unsigned t = two31 + ((unsigned)divisor >> 31);
+    unsigned anc = t - 1 - t % ad;
+    unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+    unsigned q2 = two31 / ad, r2 = two31 - q2 * ad;
+    unsigned delta;
+    int p = 31;
+    do
+    {
+      ++p;
+      q1 *= 2; r1 *= 2;
+      if (r1 >= anc) { ++q1; r1 -= anc; }
+      q2 *= 2; r2 *= 2;
+      if (r2 >= ad) { ++q2; r2 -= ad; }
+      delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    int magic = (int)(q2 + 1);
+    if (divisor < 0)
+      magic = -magic;
+    int shift = p - 32;
+
+    context.emit(I_MOVL, reg(r), reg(context.cnt_reg), line);
+    context.emit(I_MOVL, imm(magic), reg(context.val_reg));
+    context.emit(I_IMULL, reg(context.val_reg)); // high half in val_reg
+    if (divisor > 0 && magic < 0)
+      context.emit(I_ADDL, reg(context.cnt_reg), reg(context.val_reg));
+    else if (divisor < 0 && magic > 0)
+      context.emit(I_SUBL, reg(context.cnt_reg), reg(context.val_reg));
+    if (shift > 0)
+      context.emit(I_SARL, imm(shift), reg(context.val_reg));
+    context.emit(I_MOVL, reg(context.val_reg), reg(r));
+    context.emit(I_SHRL, imm(31), reg(r)); // +1 if the quotient is negative
+    context.emit(I_ADDL, reg(context.val_reg), reg(r));
+  }
+
+  /*!
+   * \brief Evaluate an expression
+   *
+   * This evaluates a binary operator into ret_reg (see operands)
+   * Children:
+   *  0. operation
+   *  1. expression
+   *  2. expression
+   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   * \throw HookError If somehow this gets called with something that's not wellformed
+   */
+
+  void expr(ASTNode *node, CompilerContext &context) 
+  { 
+    string rule = type_names[node->type];
+    unsigned line = node->lineno;
+    try
+    {
+      if (node->nodecount != 3) // binary operator
+        throw HookError("Binary operator expected (requires three sub-nodes)", rule, line);
+
+      char op = ast_char(node, 0);
+      ASTNode *c1 = ast_child(node, 1);
+      ASTNode *c2 = ast_child(node, 2);
+      if (is_yarn(node, context))
+      {
+        concat(node, context); // the YARN is left on the stack
+        return;
+      }
+      if (is_yarn(c1, context) || is_yarn(c2, context))
+        throw HookError(string("YARNs can only be added together, not: ") + op, rule, line);
+      Operand right = operands(c1, c2, context);
+      switch (op)
+      {
+        case '+':
+          context.emit(I_ADDL, right, reg(context.ret_reg), line);
+          break;
+        case '-':
+          context.emit(I_SUBL, right, reg(context.ret_reg), line);
+          break;
+        case '*':
+          if (right.kind == OPERAND_IMM)
+            multiply_by(right.value, context, line);
+          else
+            context.emit(I_IMULL, right, reg(context.ret_reg), line);
+          break;
+        case '/':
+          if (right.kind == OPERAND_IMM && right.value != 0)
+          {
+            divide_by(right.value, context, line);
+            break;
+          }
+          if (right.kind == OPERAND_IMM)
+          {
+            context.emit(I_MOVL, right, reg(context.cnt_reg));
+            right = reg(context.cnt_reg);
+          }
+          context.emit(I_CLTD, none(), none(), line);
+          context.emit(I_IDIVL, right);
+          break;
+        default:
+          throw HookError(string("Unknown operator: ") + op, rule, line);
+      }
+    }
+    catch (HookError e)
+    {
+      e.called_by(rule,line);
+      throw e;
+    }
+  }
+
+
+  /*!
+   * \brief One node of an element-wise expression (see vector_loop)
+   */
+  typedef struct {
+    char op;    /*!< '+', '-', '*' or '/'; or 'e' (an element), 'c' (a constant) or 'v' (a plain variable) */
+    int value;  /*!< The constant (or divisor), or which array or plain variable */
+    int left;   /*!< The operands of an operator (indices into VectorLoop::nodes) */
+    int right;
+  } VectorNode;
+
+  /*!
+   * \brief A loop that can be run two elements at a time (see vector_loop)
+   */
+  typedef struct {
+    ASTNode *counter;            /*!< The plain variable that counts up (I) */
+    ASTNode *bound;              /*!< What it is compared with (a number or a plain variable) */
+    char test;                   /*!< The loop is left when I > bound ('>'), I >= bound ('g') or I == bound ('=') */
+    vector<VectorNode> nodes;    /*!< The nodes of all of the expressions */
+    vector<std::pair<int,int> > stores; /*!< The statements: the array stored to and the expression stored */
+    vector<string> arrays;       /*!< The arrays indexed by I */
+    vector<bool> stored;         /*!< ... and whether each of them is stored to */
+    vector<ASTNode*> invariants; /*!< The plain variables read (which the loop doesn't change) */
+  } VectorLoop;
+
+  /*! The registers that hold the address of each array's first element in a vectorized loop */
+  static const Reg vector_bases[] = { EAX, EBX, EDX, ESI, EDI };
+
+  /*!
+   * \brief Get the name of a plain variable (an array without an index)
+   *
+   * \return NULL if the node is anything else
+   */
+
+  static const char *plain_name(ASTNode *node)
+  {
+    node = unwrap(node);
+    if (!is_rule(node, "array") || !is_rule(ast_child(node, 0), "word"))
+      return NULL;
+    return root_name(node);
+  }
+
+  /*!
+   * \brief Check that a variable exists and can never hold a YARN
+   */
+
+  static bool numbr_variable(const char *name, CompilerContext &context)
+  {
+    return context.variables[context.varcontext_stack.top()].count(name) != 0 &&
+           context.yarn_vars.count(name) == 0;
+  }
+
+  /*!
+   * \brief Check for MAH <array>!!I, where I is the loop's counter
+   *
+   * \return The array's number in vl.arrays, or -1
+   */
+
+  static int vector_element(ASTNode *node, VectorLoop &vl, CompilerContext &context)
+  {
+    node = unwrap(node);
+    if (!is_rule(node, "array") || node->nodecount != 2)
+      return -1;
+    const char *name = plain_name(ast_child(node, 0));
+    const char *index = plain_name(ast_child(node, 1));
+    const char *counter = plain_name(vl.counter);
+    if (name == NULL || index == NULL || strcmp(index, counter) != 0 || strcmp(name, counter) == 0 ||
+        !numbr_variable(name, context))
+      return -1;
+    for (unsigned i = 0; i < vl.arrays.size(); ++i)
+    {
+      if (vl.arrays[i] == name)
+        return i;
+    }
+    vl.arrays.push_back(name);
+    vl.stored.push_back(false);
+    return vl.arrays.size() - 1;
+  }
+
+  static int vector_expr(ASTNode *node, VectorLoop &vl, CompilerContext &context);
+
+  /*!
+   * \brief Add an operator node whose left operand is already a VectorNode
+   *
+   * \return The new node, or -1 if the right operand can't be vectorized
+   */
+
+  static int vector_op(char op, int left, ASTNode *right, VectorLoop &vl, CompilerContext &context)
+  {
+    VectorNode n = { op, 0, left, -1 };
+    if (op == '/')
+    { // only by a power of two
+      if (!constant_value(unwrap(right), n.value) || n.value == 0 || n.value == INT_MIN)
+        return -1;
+      unsigned ad = (n.value < 0) ? -n.value : n.value;
+      if ((ad & (ad - 1)) != 0)
+        return -1;
+    }
+    else if ((n.right = vector_expr(right, vl, context)) < 0)
+    {
+      return -1;
+    }
+    vl.nodes.push_back(n);
+    return vl.nodes.size() - 1;
+  }
+
+  /*!
+   * \brief Turn an expression into VectorNodes
+   *
+   * Elements indexed by the counter, constants and plain variables can be
+   * added, subtracted and multiplied, and divided by a power of two.
+   *
+   * \return The root node, or -1 if the expression can't be vectorized
+   */
+
+  static int vector_expr(ASTNode *node, VectorLoop &vl, CompilerContext &context)
+  {
+    VectorNode n = { 'c', 0, -1, -1 };
+    const char *name;
+    node = unwrap(node);
+    if (constant_value(node, n.value))
+    {
+      n.op = 'c';
+    }
+    else if ((n.value = vector_element(node, vl, context)) >= 0)
+    {
+      n.op = 'e';
+    }
+    else if ((name = plain_name(node)) != NULL)
+    {
+      if (strcmp(name, plain_name(vl.counter)) == 0 || !numbr_variable(name, context))
+        return -1;
+      n.op = 'v';
+      for (n.value = 0; n.value < (int)vl.invariants.size(); ++n.value)
+      {
+        if (strcmp(plain_name(vl.invariants[n.value]), name) == 0)
+          break;
+      }
+      if (n.value == (int)vl.invariants.size())
+        vl.invariants.push_back(node);
+    }
+    else if (is_rule(node, "expr") && node->nodecount == 3 && strchr("+-*/", ast_char(node, 0)) != NULL)
+    {
+      int left = vector_expr(ast_child(node, 1), vl, context);
+      return (left < 0) ? -1 : vector_op(ast_char(node, 0), left, ast_child(node, 2), vl, context);
+    }
+    else
+    {
+      return -1;
+    }
+    vl.nodes.push_back(n);
+    return vl.nodes.size() - 1;
+  }
+
+  /*!
+   * \brief How many SSE registers an expression needs
+   */
+
+  static int vector_need(const VectorLoop &vl, int n)
+  {
+    const VectorNode &node = vl.nodes[n];
+    switch (node.op)
+    {
+      case 'e':
+      case 'c':
+      case 'v':
+        return 1;
+      case '/':
+        return vector_need(vl, node.left);
+    }
+    return std::max(vector_need(vl, node.left), vector_need(vl, node.right) + 1);
+  }
+
+  /*!
+   * \brief Recognize a counted element-wise loop
+   *
+   * The body has to be nothing but statements that store to MAH A!!I (an
+   * expression of elements MAH B!!I, constants and variables the loop doesn't
+   * change), followed by UPZ I!! and IZ <I past the bound> GTFO KTHX, where
+   * the bound is a constant or a variable the loop doesn't change.  Each
+   * iteration only touches the elements at I, so nothing depends on an
+   * earlier iteration and any number of them can be done at once.
+   *
+   * \param stmts The body of the loop
+   * \param vl Where to put what was found
+   * \param context The compiler context
+   * \return true if the loop can be vectorized
+   */
+
+  static bool vector_loop(ASTNode *stmts, VectorLoop &vl, CompilerContext &context)
+  {
+    vector<ASTNode*> body;
+    for (unsigned i = 0; i < stmts->nodecount; ++i)
+    {
+      if (!is_rule(ast_child(stmts, i), "comment"))
+        body.push_back(ast_child(stmts, i));
+    }
+    if (body.size() < 3)
+      return false;
+
+    // UPZ I!!1
+    ASTNode *step = body[body.size()-2];
+    int value;
+    if (!is_rule(step, "self_assignment") || ast_char(step, 0) != '+' ||
+        !constant_value(ast_child(step, 2), value) || value != 1)
+      return false;
+    vl.counter = ast_child(step, 1);
+    const char *counter = plain_name(vl.counter);
+    if (counter == NULL || !numbr_variable(counter, context))
+      return false;
+
+    // IZ <I past the bound> GTFO KTHX
+    ASTNode *test = body.back();
+    if (!is_rule(test, "conditional") || test->nodecount != 2)
+      return false;
+    ASTNode *then = ast_child(test, 1);
+    unsigned breaks = 0, others = 0;
+    for (unsigned i = 0; i < then->nodecount; ++i)
+    {
+      ASTNode *stmt = ast_child(then, i);
+      if (is_rule(stmt, "brk"))
+        ++breaks;
+      else if (!is_rule(stmt, "comment"))
+        ++others;
+    }
+    if (breaks != 1 || others != 0)
+      return false;
+    ASTNode *cond = ast_child(test, 0);
+    bool negated = false;
+    if (cond->nodecount == 2 && ast_char(cond, 0) == '!')
+    {
+      negated = true;
+      cond = ast_child(cond, 1);
+    }
+    if (cond->nodecount != 3)
+      return false;
+    char op = ast_char(cond, 0);
+    const char *left = plain_name(ast_child(cond, 1));
+    const char *right = plain_name(ast_child(cond, 2));
+    if (left != NULL && strcmp(left, counter) == 0)
+    { // BIGR I AN N, NOT SMALR I AN N, LIEK I AN N
+      vl.bound = unwrap(ast_child(cond, 2));
+      vl.test = (op == '>' && !negated) ? '>' : (op == '<' && negated) ? 'g' : (op == '=' && !negated) ? '=' : 0;
+    }
+    else if (right != NULL && strcmp(right, counter) == 0)
+    { // SMALR N AN I, NOT BIGR N AN I, LIEK N AN I
+      vl.bound = unwrap(ast_child(cond, 1));
+      vl.test = (op == '<' && !negated) ? '>' : (op == '>' && negated) ? 'g' : (op == '=' && !negated) ? '=' : 0;
+    }
+    else
+    {
+      return false;
+    }
+    if (vl.test == 0)
+      return false;
+    const char *bound = plain_name(vl.bound);
+    if (constant_value(vl.bound, value) ? value < 0 :
+        (bound == NULL || strcmp(bound, counter) == 0 || !numbr_variable(bound, context)))
+      return false;
+
+    // The element-wise statements
+    for (unsigned i = 0; i + 2 < body.size(); ++i)
+    {
+      ASTNode *stmt = body[i];
+      int target, expr;
+      if (is_rule(stmt, "assignment"))
+      {
+        if ((target = vector_element(ast_child(stmt, 0), vl, context)) < 0 ||
+            (expr = vector_expr(ast_child(stmt, 1), vl, context)) < 0)
+          return false;
+      }
+      else if (is_rule(stmt, "self_assignment"))
+      { // UPZ MAH A!!I!!<expr> is MAH A!!I R SUM OF MAH A!!I AN <expr>
+        int left;
+        if ((target = vector_element(ast_child(stmt, 1), vl, context)) < 0 ||
+            (left = vector_expr(ast_child(stmt, 1), vl, context)) < 0 ||
+            (expr = vector_op(ast_char(stmt, 0), left, ast_child(stmt, 2), vl, context)) < 0)
+          return false;
       }
-      cout << "Done with array!" << endl;
+      else
+      {
+        return false;
+      }
+      if (vector_need(vl, expr) > 6) // xmm6 and xmm7 are spoken for
+        return false;
+      vl.stored[target] = true;
+      vl.stores.push_back(std::make_pair(target, expr));
     }
-    catch (HookError e)
+    if (vl.stores.empty() || vl.arrays.size() > sizeof(vector_bases) / sizeof(vector_bases[0]))
+      return false;
+
+    // Anything read as a plain variable must not be one of the arrays stored
+    // to (X is MAH X!!0)
+    for (unsigned a = 0; a < vl.arrays.size(); ++a)
     {
-      e.called_by(rule,line);
-      throw e;
+      if (!vl.stored[a])
+        continue;
+      if (bound != NULL && vl.arrays[a] == bound)
+        return false;
+      for (unsigned v = 0; v < vl.invariants.size(); ++v)
+      {
+        if (vl.arrays[a] == plain_name(vl.invariants[v]))
+          return false;
+      }
     }
+    return true;
   }
 
   /*!
-   * \brief Run an assignment
-   *
-   * This handles assignment of variables (and declaration as well)
-   * Children:
-   *  0. l_value
-   *  1. r_value
-   * 
-   * \param node The node to traverse
-   * \param context The compiler context
-   * \return The standard hook return
-   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   * \brief Get the label of a vector of {value, 0, value, 0} (two NUMBR value_ts)
    */
 
-  void assignment(ASTNode *node, CompilerContext &context) 
-  { 
-    string rule = type_names[node->type];
-    unsigned line = node->lineno;
-    try
-    {
-      ASTNode *l_value = (ASTNode*)node->nodes[0];
-      ASTNode *r_value = (ASTNode*)node->nodes[1];
-
-      cout << string(context.context_stack.size()*2, ' ') << "LOL " << std::flush;
-      context.flags["r_value"] = true;
-      hook_search( type_names[l_value->type] )(l_value, context);
-      context.flags["r_value"] = false;
-      cout << " R " << std::flush;
-      context.flags["l_value"] = true;
-      hook_search( type_names[r_value->type] )(r_value, context);
-      context.flags["l_value"] = false;
-      cout << endl;
-    }
-    catch (HookError e)
+  static Operand vector_constant(int value, CompilerContext &context)
+  {
+    string &label = context.int_constants[value];
+    if (label.empty())
     {
-      e.called_by(rule,line);
-      throw e;
+      label = ".Lvec" + std::to_string(context.counter++);
+      context.header_raw("  .balign 16\n" + label + ":\n  .long " + std::to_string(value) + ", 0, " +
+                         std::to_string(value) + ", 0\n");
     }
+    return context.symbol(label);
   }
 
   /*!
-   * \brief Break out of a loop
+   * \brief Evaluate an element-wise expression into an SSE register
    *
-   * This handles assignment of variables (and declaration as well)
-   * Children:
-   *  - none -
-   * 
-   * \param node The node to traverse
-   * \param context The compiler context
-   * \return The standard hook return
-   * \throw HookError if there is no enclosing loop* context
+   * The NUMBRs are in the low halves of the value_ts (the even dwords), which
+   * are the ones pmuludq multiplies; the odd dwords are junk until the result
+   * is masked before it is stored.
+   *
+   * \param n The node to evaluate
+   * \param t The register to leave it in (XMM0 + t); the ones after it are free
+   * \param pair Two elements (movdqu) or one (movq)
+   * \param invariants Where the plain variables were copied to (from %esp)
    */
 
-  void brk(ASTNode *node, CompilerContext &context) 
-  { 
-    string rule = type_names[node->type];
-    unsigned line = node->lineno;
-    string ctext;
-    { // Find the top-most context with loop in it
-      stack<string> temp;
-      while (context.context_stack.empty() == false)
-      {
-        if (context.context_stack.top().find("loop") == 0) // loop context
-          break;
-        temp.push( context.context_stack.top() );
-        context.context_stack.pop();
-      }
-      if (context.context_stack.empty())
-        throw HookError("BREAK found outside of loop!", rule, line);
-      else
-        ctext = context.context_stack.top();
-      while (temp.empty() == false)
-      {
-        context.context_stack.push( temp.top() );
-        temp.pop();
+  static void vector_value(const VectorLoop &vl, int n, int t, bool pair, int invariants, CompilerContext &context)
+  {
+    const VectorNode &node = vl.nodes[n];
+    Reg x = (Reg)(XMM0 + t);
+    switch (node.op)
+    {
+      case 'e':
+        context.emit(pair ? I_MOVDQU : I_MOVQ, mem(vector_bases[node.value], context.cnt_reg, 1), reg(x));
+        return;
+      case 'c':
+        context.emit(I_MOVDQU, vector_constant(node.value, context), reg(x));
+        return;
+      case 'v':
+        context.emit(I_MOVDQU, mem(context.stack_ptr, invariants + 16 * node.value), reg(x));
+        return;
+      case '/':
+      { // the same as divide_by, a lane at a time
+        unsigned ad = (node.value < 0) ? -node.value : node.value;
+        int k = __builtin_ctz(ad);
+        vector_value(vl, node.left, t, pair, invariants, context);
+        if (k > 0)
+        {
+          context.emit(I_MOVDQA, reg(x), reg(XMM6));
+          context.emit(I_PSRAD, imm(31), reg(XMM6));
+          context.emit(I_PSRLD, imm(32 - k), reg(XMM6));
+          context.emit(I_PADDD, reg(XMM6), reg(x));
+          context.emit(I_PSRAD, imm(k), reg(x));
+        }
+        if (node.value < 0)
+        {
+          context.emit(I_PXOR, reg(XMM6), reg(XMM6));
+          context.emit(I_PSUBD, reg(x), reg(XMM6));
+          context.emit(I_MOVDQA, reg(XMM6), reg(x));
+        }
+        return;
       }
     }
-    cout << string(context.context_stack.size()*2, ' ') << "BTW Break from " << ctext << std::endl;
-    cout << string(context.context_stack.size()*2, ' ') << "GTFO" << std::endl;
+    vector_value(vl, node.left, t, pair, invariants, context);
+    vector_value(vl, node.right, t + 1, pair, invariants, context);
+    Opcode op = (node.op == '+') ? I_PADDD : (node.op == '-') ? I_PSUBD : I_PMULUDQ;
+    context.emit(op, reg((Reg)(x + 1)), reg(x));
   }
 
   /*!
-   * \brief Evaluate a conditional
-   *
-   * This handles the conditional statements
-   * Children:
-   *  0. condition
-   *  1. then-statements
-   *  2. (optionaal) else-statements
-   * 
-   * \param node The node to traverse
-   * \param context The compiler context
-   * \return The standard hook return
-   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   * \brief Do every statement of a vectorized loop for the element(s) at %ecx
    */
 
-  void conditional(ASTNode *node, CompilerContext &context) 
-  { 
-    string rule = type_names[node->type];
-    unsigned line = node->lineno;
-    string ctext = "cond"+convert<int,string>(context.counter++);
-    try
+  static void vector_body(const VectorLoop &vl, bool pair, int invariants, CompilerContext &context)
+  {
+    for (unsigned s = 0; s < vl.stores.size(); ++s)
     {
-      ASTNode *cond = (ASTNode*)node->nodes[0];
-      ASTNode *tbranch = (ASTNode*)node->nodes[1];
-      ASTNode *ebranch = (ASTNode*)node->nodes[2];
+      vector_value(vl, vl.stores[s].second, 0, pair, invariants, context);
+      context.emit(I_PAND, reg(XMM7), reg(XMM0)); // a NUMBR: the high half is 0
+      context.emit(pair ? I_MOVDQU : I_MOVQ, reg(XMM0), mem(vector_bases[vl.stores[s].first], context.cnt_reg, 1));
+    }
+  }
 
-      cout << string( context.context_stack.size()*2, ' ');
-      cout << "IZ " << std::flush;
-      context.context_stack.push(ctext);
-      hook_search( type_names[cond->type] )(cond, context);
-      context.context_stack.pop();
-      cout << endl;
+  /*!
+   * \brief A slot in the frame that vector_prefix keeps on the stack
+   */
 
-      context.context_stack.push(ctext+"then");
-      hook_search( type_names[tbranch->type] )(tbranch, context);
-      context.context_stack.pop();
+  static Operand frame_slot(int frame, int offset, CompilerContext &context)
+  {
+    return mem(context.stack_ptr, context.stack_depth - frame + offset);
+  }
 
-      if (node->nodecount == 3)
-      {
-        cout << string( context.context_stack.size()*2, ' ');
-        cout << "NOWAI" << endl;
+  /*!
+   * \brief Do the first iterations of a loop found by vector_loop with SSE2
+   *
+   * This goes in front of the loop.  It works out how many iterations come
+   * before the last one and gets the address of the first element of each
+   * array from the runtime (lol_bukkit_span), making room in the ones that are
+   * stored to.  The elements are then done two at a time (one first, if that
+   * lines the stores up on 16 bytes) and I is set to where that stopped.  The
+   * loop itself does the rest, as it does everything if the bound is
+   * negative, there are fewer than 4 iterations or any of the arrays is not
+   * a dense block of plain NUMBRs.
+   *
+   * \param vl What vector_loop found
+   * \param ctext The loop's context (for the labels)
+   * \param context The compiler context
+   */
 
-        context.context_stack.push(ctext+"else");
-        hook_search( type_names[ebranch->type] )(ebranch, context);
-        context.context_stack.pop();
+  static void vector_prefix(const VectorLoop &vl, const string &ctext, CompilerContext &context)
+  {
+    string vtext = context.varcontext_stack.top();
+    string top = ".L" + ctext + "_vec", done = top + "_end", skip = top + "_skip";
+    // frame: I, &I, count, last offset, the arrays' addresses, the plain variables
+    int bases = 16, invariants = bases + 4 * vl.arrays.size();
+    int size = invariants + 16 * vl.invariants.size();
+    int value;
+
+    context.emit(I_SUBL, imm(size), reg(context.stack_ptr), "vectorized " + ctext);
+    int frame = context.stack_depth;
+    run_hook(vl.counter, context); // value in ret_reg, address in dim_reg
+    context.emit(I_MOVL, reg(context.ret_reg), frame_slot(frame, 0, context));
+    context.emit(I_MOVL, reg(context.dim_reg), frame_slot(frame, 4, context));
+    context.emit(I_CMPL, imm(0), reg(context.ret_reg));
+    context.emit(I_JL, context.symbol(skip));
+    if (constant_value(vl.bound, value))
+    {
+      context.emit(I_MOVL, imm(value), reg(context.ret_reg));
+    }
+    else
+    {
+      run_hook(vl.bound, context);
+      context.emit(I_CMPL, imm(0), reg(context.ret_reg));
+      context.emit(I_JL, context.symbol(skip));
+    }
+    if (vl.test != '>') // the last iteration is bound-1
+      context.emit(I_SUBL, imm(1), reg(context.ret_reg));
+    context.emit(I_SUBL, frame_slot(frame, 0, context), reg(context.ret_reg));
+    context.emit(I_CMPL, imm(4), reg(context.ret_reg));
+    context.emit(I_JL, context.symbol(skip));
+    context.emit(I_CMPL, imm(0x8000000), reg(context.ret_reg)); // the offsets have to fit
+    context.emit(I_JG, context.symbol(skip));
+    context.emit(I_MOVL, reg(context.ret_reg), frame_slot(frame, 8, context));
+    context.emit(I_SHLL, imm(3), reg(context.ret_reg));
+    context.emit(I_SUBL, imm(16), reg(context.ret_reg));
+    context.emit(I_MOVL, reg(context.ret_reg), frame_slot(frame, 12, context));
+
+    for (unsigned v = 0; v < vl.invariants.size(); ++v)
+    {
+      int slot = invariants + 16 * v;
+      run_hook(vl.invariants[v], context);
+      context.emit(I_MOVL, reg(context.ret_reg), frame_slot(frame, slot, context));
+      context.emit(I_MOVL, imm(0), frame_slot(frame, slot + 4, context));
+      context.emit(I_MOVL, reg(context.ret_reg), frame_slot(frame, slot + 8, context));
+      context.emit(I_MOVL, imm(0), frame_slot(frame, slot + 12, context));
+    }
+    for (int pass = 1; pass >= 0; --pass)
+    { // the ones stored to first: making room may move them
+      for (unsigned a = 0; a < vl.arrays.size(); ++a)
+      {
+        if (vl.stored[a] != (pass == 1))
+          continue;
+        context.emit(I_PUSH, imm(pass ? LOL_AT_STORE : 0));
+        context.emit(I_PUSH, frame_slot(frame, 8, context));
+        context.emit(I_PUSH, frame_slot(frame, 0, context));
+        context.emit(I_PUSH, var_slot(vtext, vl.arrays[a], context), none(), vl.arrays[a]);
+        context.emit(I_CALL, context.symbol("lol_bukkit_span"));
+        context.emit(I_ADDL, imm(16), reg(context.stack_ptr));
+        context.emit(I_CMPL, imm(0), reg(context.ret_reg));
+        context.emit(I_JE, context.symbol(skip));
+        context.emit(I_MOVL, reg(context.ret_reg), frame_slot(frame, bases + 4 * a, context));
       }
+    }
 
+    for (unsigned a = 0; a < vl.arrays.size(); ++a)
+      context.emit(I_MOVL, frame_slot(frame, bases + 4 * a, context), reg(vector_bases[a]));
+    context.emit(I_MOVDQU, vector_constant(-1, context), reg(XMM7)); // the mask: {-1, 0, -1, 0}
+    context.emit(I_XORL, reg(context.cnt_reg), reg(context.cnt_reg));
+    context.emit(I_TESTL, imm(8), reg(vector_bases[vl.stores[0].first]));
+    context.emit(I_JE, context.symbol(top));
+    vector_body(vl, false, invariants, context);
+    context.emit(I_MOVL, imm(8), reg(context.cnt_reg));
+    context.emit(I_LABEL, context.symbol(top));
+    context.emit(I_CMPL, frame_slot(frame, 12, context), reg(context.cnt_reg));
+    context.emit(I_JG, context.symbol(done));
+    vector_body(vl, true, invariants, context);
+    context.emit(I_ADDL, imm(16), reg(context.cnt_reg));
+    context.emit(I_JMP, context.symbol(top));
+    context.emit(I_LABEL, context.symbol(done));
+    context.emit(I_SHRL, imm(3), reg(context.cnt_reg)); // elements done
+    context.emit(I_ADDL, frame_slot(frame, 0, context), reg(context.cnt_reg));
+    context.emit(I_MOVL, frame_slot(frame, 4, context), reg(context.val_reg));
+    context.emit(I_MOVL, reg(context.cnt_reg), mem(context.val_reg));
+    context.emit(I_MOVL, imm(0), mem(context.val_reg, 4));
+    context.emit(I_LABEL, context.symbol(skip));
+    pop_to(frame - size, context);
+  }
 
-      cout << string( context.context_stack.size()*2, ' ');
-      cout << "KTHX" << endl;
-    }
-    catch (HookError e)
+  /*!
+   * \brief Count the plain reads of each variable's elements under a node
+   *
+   *   A variable that is assigned to, declared, incremented or read into
+   * anywhere under the node (and so may have its elements moved) is put in
+   * stored instead.
+   */
+
+  static void loop_arrays(ASTNode *node, map<string,unsigned> &reads, set<string> &stored)
+  {
+    if (is_rule(node, "assignment") || is_rule(node, "declaration"))
+      stored.insert(root_name(ast_child(node, 0)));
+    else if (is_rule(node, "self_assignment") || is_rule(node, "input"))
+      stored.insert(root_name(ast_child(node, 1)));
+    else if (is_rule(node, "array") && node->nodecount == 2 && is_rule(ast_child(ast_child(node, 0), 0), "word"))
+      ++reads[root_name(node)];
+    for (unsigned i = 0; i < node->nodecount; ++i)
     {
-      e.called_by(rule,line);
-      throw e;
+      if (ast_kind(node, i) == AST_NODE && ast_slot(node, i) != 0)
+        loop_arrays(ast_child(node, i), reads, stored);
     }
   }
 
   /*!
-   * \brief Evaluate a conditional expression
+   * \brief Load where a variable's elements are into ptr_reg and frame_ptr
    *
-   * This handles the conditional expressions
-   * Children:
-   *  0. boolean
-   *   -or-
-   *  0. unary op
-   *  1. conditional expression
-   *   -or-
-   *  0. binary op
-   *  1. conditional expression
-   *  2. conditional expression
-   * 
-   * \param node The node to traverse
-   * \param context The compiler context
-   * \return The standard hook return
-   * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
+   *   ptr_reg gets the variable's dense block and frame_ptr its length, or 0
+   * (so that every element is looked up by lol_bukkit_at) when the variable
+   * is sparse or some element may hold a nested BUKKIT.  This is only right
+   * for as long as nothing is stored to the variable.
    */
 
-  void condexpr(ASTNode *node, CompilerContext &context) 
-  { 
-    string rule = type_names[node->type];
-    unsigned line = node->lineno;
-    string ctext = context.context_stack.top(); // know where to jump
-    try
-    {
-      ASTNode *op = (ASTNode*)node->nodes[0];
-      ASTNode *c1 = (ASTNode*)node->nodes[1];
-      ASTNode *c2 = (ASTNode*)node->nodes[2];
+  static void pin_array(const string &name, CompilerContext &context)
+  {
+    string done = ".Lpin" + std::to_string(context.counter++);
+    context.emit(I_MOVL, var_slot(context.varcontext_stack.top(), name, context), reg(context.var_reg), name);
+    context.emit(I_XORL, reg(context.frame_ptr), reg(context.frame_ptr));
+    context.emit(I_MOVL, mem(context.var_reg, 12), reg(context.ptr_reg)); // vals
+    context.emit(I_CMPL, imm(TYPE_BUKKIT), mem(context.var_reg)); // var_type
+    context.emit(I_JE, context.symbol(done));
+    context.emit(I_TESTL, reg(context.ptr_reg), reg(context.ptr_reg));
+    context.emit(I_JE, context.symbol(done));
+    context.emit(I_MOVL, mem(context.var_reg, 8), reg(context.frame_ptr)); // dims
+    context.emit(I_MOVL, mem(context.frame_ptr), reg(context.frame_ptr));
+    context.emit(I_LABEL, context.symbol(done));
+  }
 
-      if (node->nodecount == 1) // strict boolean literal
-      {
-        bool boolean = ( *(int*)(op) ) == 1;
-        if (boolean)
-          cout << "WIN" << std::flush;
-        else
-          cout << "FAIL" << std::flush;
-      }
-      else if (node->nodecount == 2) // unary operator
-      {
-        char unary = *(char*)(op);
-        switch (unary)
-        {
-          case '!':
-            cout << "NOT " << std::flush; break;
-        }
-        hook_search( type_names[c1->type] )(c1, context);
-      }
-      else if (node->nodecount == 3) // binary operator
+  /*!
+   * \brief Pick the variable a loop should pin (see pin_array)
+   *
+   * \return The variable whose elements the body reads most and never stores
+   * to, or the one that is pinned already if it is read as much
+   */
+
+  static string loop_pin(ASTNode *body, CompilerContext &context)
+  {
+    map<string,unsigned> reads;
+    set<string> stored;
+    loop_arrays(body, reads, stored);
+    map<string,string> &declared = context.variables[context.varcontext_stack.top()];
+    string best = context.pinned;
+    unsigned most = reads.count(best) ? reads[best] : 0;
+    for (map<string,unsigned>::iterator r = reads.begin(); r != reads.end(); ++r)
+    {
+      if (r->second > most && stored.count(r->first) == 0 && declared.count(r->first) != 0 &&
+          !is_scalar(r->first, context))
       {
-        char binary = *(char*)(op);
-        switch (binary)
-        {
-          case '>':
-            cout << "BIGR " << std::flush; break;
-          case '<':
-            cout << "SMALR " << std::flush; break;
-          case '=':
-            cout << "LIEK " << std::flush; break;
-          case '|':
-            cout << "OR " << std::flush; break;
-          case '&':
-            cout << "AND " << std::flush; break;
-          case '^':
-            cout << "XOR " << std::flush; break;
-        }
-        hook_search( type_names[c1->type] )(c1, context);
-        cout << " AN " << std::flush;
-        hook_search( type_names[c2->type] )(c2, context);
+        best = r->first;
+        most = r->second;
       }
     }
-    catch (HookError e)
-    {
-      e.called_by(rule,line);
-      throw e;
-    }
+    return best;
   }
 
-
   /*!
-   * \brief Evaluate a constant
+   * \brief Run a loop
    *
-   * This handles assignment of variables (and declaration as well)
+   * This handles the infinite looping mechanism.  Anything the body puts
+   * on the stack is popped before jumping back to the top.  A counted
+   * element-wise loop gets an SSE2 version of its first iterations in front
+   * of it (see vector_loop), unless the "no_vectorize" flag is set.  The
+   * dense block of the variable the body reads most without storing to it
+   * is loaded before the loop (see pin_array), and the enclosing loop's is
+   * loaded again after it.
    * Children:
-   *  0. value
-   *    - Valid types:
-   *      a. number
-   *      b. string
+   *  0. Loop label
+   *  1. Statements
    * 
    * \param node The node to traverse
    * \param context The compiler context
@@ -667,23 +2508,38 @@ namespace LOLCode
    * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
    */
 
-  void constant(ASTNode *node, CompilerContext &context) 
+  void loop(ASTNode *node, CompilerContext &context) 
   { 
     string rule = type_names[node->type];
     unsigned line = node->lineno;
-    string number_type = "number";
-    string string_type = "string";
+    string ctext = "loop" + std::to_string(context.counter++);
     try
     {
-      ASTNode *value = node;
-      if (number_type == type_names[value->type])
-      {
-        cout << *(int*)(value->nodes[0]) << std::flush;
-      } // number constant
-      else
+      ASTNode *inner = ast_child(node, 1);
+      VectorLoop vl;
+
+      string outer = context.pinned;
+      bool clobbered = false;
+
+      if (!context.flags["no_vectorize"] && vector_loop(inner, vl, context))
       {
-        cout << "\"" << (char*)(value->nodes[0]) << std::flush;
-      } // string constant
+        vector_prefix(vl, ctext, context);
+        clobbered = vl.arrays.size() >= sizeof(vector_bases) / sizeof(vector_bases[0]); // it used ptr_reg
+      }
+      context.pinned = loop_pin(inner, context);
+      if (!context.pinned.empty() && (context.pinned != outer || clobbered))
+        pin_array(context.pinned, context);
+      context.emit(I_LABEL, context.symbol(".L" + ctext), none(), line);
+      context.context_stack.push(ctext);
+      unsigned scope = enter_block(ctext, context);
+      run_hook(inner, context);
+      leave_block(ctext, scope, context);
+      context.emit(I_JMP, context.symbol(".L" + ctext));
+      context.context_stack.pop();
+      context.emit(I_LABEL, context.symbol(".L" + ctext + "_end"));
+      if (context.pinned != outer && !outer.empty())
+        pin_array(outer, context);
+      context.pinned = outer;
     }
     catch (HookError e)
     {
@@ -693,48 +2549,53 @@ namespace LOLCode
   }
 
   /*!
-   * \brief Evaluate an expression
+   * \brief End the program
    *
-   * This handles accessing arrays, and expanding them if necessary
+   * This handles BYES and DIAF.  The message (if any) goes to stdout for BYES
+   * and to stderr for DIAF; the status defaults to 0 for BYES and 1 for DIAF.
    * Children:
-   *  0. operation
-   *  1. expression
-   *  2. expression
+   *  0. 'B' (BYES) or 'D' (DIAF)
+   *  1. exit_status
+   *  2. exit_message
+   * 
+   * \param node The node to traverse
+   * \param context The compiler context
+   * \return The standard hook return
    * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
-   * \throw HookError If somehow this gets called with something that's not wellformed
    */
 
-  void expr(ASTNode *node, CompilerContext &context) 
+  void exit_program(ASTNode *node, CompilerContext &context) 
   { 
     string rule = type_names[node->type];
     unsigned line = node->lineno;
-    //string ctext = context.context_stack.top(); // know where to jump
     try
     {
-      ASTNode *op = (ASTNode*)node->nodes[0];
-      ASTNode *c1 = (ASTNode*)node->nodes[1];
-      ASTNode *c2 = (ASTNode*)node->nodes[2];
+      bool diaf = (ast_char(node, 0) == 'D');
+      ASTNode *status = ast_child(node, 1);
+      ASTNode *message = ast_child(node, 2);
+      int depth = context.stack_depth;
 
-      if (node->nodecount == 3) // binary operator
+      if (message->nodecount == 1)
       {
-        char binary = *(char*)(op);
-        switch (binary)
-        {
-          case '+':
-            cout << "UP " << std::flush; break;
-          case '-':
-            cout << "NERF " << std::flush; break;
-          case '*':
-            cout << "TIEMZ " << std::flush; break;
-          case '/':
-            cout << "OVAR " << std::flush; break;
-        }
-        hook_search( type_names[c1->type] )(c1, context);
-        cout << " AN " << std::flush;
-        hook_search( type_names[c2->type] )(c2, context);
+        ASTNode *text = as_expr(ast_child(message, 0));
+        yarn_value(text, context); // (a temporary is not worth freeing now)
+        free_expr(text, ast_child(message, 0));
+        context.emit(I_PUSH, reg(context.ret_reg));
+        context.emit(I_CALL, context.symbol(diaf ? "lol_print_error" : "lol_print_yarn"), none(), line);
+        if (!diaf)
+          context.emit(I_CALL, context.symbol("lol_print_newline"));
+      }
+      if (status->nodecount == 1)
+      {
+        ASTNode *value = as_expr(ast_child(status, 0));
+        run_hook(value, context);
+        free_expr(value, ast_child(status, 0));
       }
       else
-        throw HookError("Binary operator expected (requires three sub-nodes)", rule, line);
+        context.emit(I_MOVL, imm(diaf ? 1 : 0), reg(context.ret_reg), line);
+      context.emit(I_PUSH, reg(context.ret_reg));
+      context.emit(I_CALL, context.symbol("lol_exit"));
+      context.stack_depth = depth; // lol_exit does not come back
     }
     catch (HookError e)
     {
@@ -743,14 +2604,17 @@ namespace LOLCode
     }
   }
 
-
   /*!
-   * \brief Run a loop
+   * \brief Handle input
    *
-   * This handles the infinite looping mechanism
+   * This handles GIMMEH statements, which read a YARN from stdin (or OUTTA a
+   * file) into a variable (declaring it if need be).  The file is named by
+   * the YARN in a variable, or by the word itself if there is no such
+   * variable; the runtime opens it the first time it is read from.
    * Children:
-   *  0. Loop label
-   *  1. Statements
+   *  0. input_type ('L'ine (the default), 'W'ord or 'C' for a LETTAR)
+   *  1. array
+   *  2. input_from (a word, or nothing for stdin)
    * 
    * \param node The node to traverse
    * \param context The compiler context
@@ -758,23 +2622,53 @@ namespace LOLCode
    * \throw HookError if a sub-node is not a recognized type (i.e. can't be executed)
    */
 
-  void loop(ASTNode *node, CompilerContext &context) 
+  void input(ASTNode *node, CompilerContext &context) 
   { 
     string rule = type_names[node->type];
     unsigned line = node->lineno;
     try
     {
-      ASTNode *label = (ASTNode*)node->nodes[0];
-      ASTNode *inner = (ASTNode*)node->nodes[1];
+      ASTNode *type = ast_child(node, 0);
+      ASTNode *l_value = ast_child(node, 1);
+      ASTNode *from = ast_child(node, 2);
+      bool file = is_rule(from, "word");
 
-      cout << string( context.context_stack.size()*2, ' ');
-      cout << "IM IN YR " << (char *)(label->nodes[0]) << endl;
-      context.context_stack.push("loop"+convert<int,string>(context.counter++));
-      hook_search( type_names[inner->type] )(inner, context);
-      context.context_stack.pop();
-      cout << string( context.context_stack.size()*2, ' ');
-      cout << "KTHX" << endl;
-      free(label->nodes[0]);
+      string reader = "lol_gimmeh_line";
+      if (type->nodecount == 1 && ast_char(type, 0) == 'W')
+        reader = "lol_gimmeh_word";
+      else if (type->nodecount == 1 && ast_char(type, 0) == 'C')
+        reader = "lol_gimmeh_lettar";
+
+      context.flags["r_value"] = true;
+      run_hook(l_value, context); // address in dim_reg
+      context.flags["r_value"] = false;
+      context.emit(I_PUSH, reg(context.dim_reg));
+      int slot = context.stack_depth;
+      if (!file)
+      {
+        context.emit(I_CALL, context.symbol(reader), none(), line);
+        context.emit(I_ADDL, imm(4), reg(context.stack_ptr));
+      }
+      else
+      { // reader(yarn, name)
+        bool temp = false;
+        if (context.variables[context.varcontext_stack.top()].count(ast_text(from, 0)) != 0)
+        {
+          ASTNode *path = as_expr(from);
+          temp = yarn_value(path, context);
+          free_expr(path, from);
+        }
+        else
+          yarn(from, context);
+        int name = context.stack_depth;
+        context.emit(I_PUSH, reg(context.ret_reg));
+        context.emit(I_PUSH, mem(context.stack_ptr, context.stack_depth - slot));
+        context.emit(I_CALL, context.symbol(reader + "_from"), none(), line);
+        pop_to(name, context);
+        if (temp)
+          free_yarn(name, context);
+        pop_to(slot - 4, context);
+      }
     }
     catch (HookError e)
     {
@@ -786,7 +2680,8 @@ namespace LOLCode
   /*!
    * \brief Handle output
    *
-   * This handles initializer statements
+   * This handles VISIBLE statements.  The text goes into the runtime's
+   * output buffer (see lol_print_numbr and friends in asmutil).
    * Children:
    *  0. expr
    *  1. newline-suppressor (optional)
@@ -803,11 +2698,27 @@ namespace LOLCode
     unsigned line = node->lineno;
     try
     {
-      ASTNode *expr = (ASTNode*)node->nodes[0];
-      hook_search( type_names[expr->type] )(expr, context);
-      if (node->nodecount == 2)
-        cout << "!" << std::flush;
-      cout << endl;
+      ASTNode *expr = ast_child(node, 0);
+      int depth = context.stack_depth;
+      if (may_be_yarn(expr, context))
+      { // (lol_print_yarn prints a NUMBR too)
+        bool temp = yarn_value(expr, context);
+        int after = context.stack_depth;
+        context.emit(I_PUSH, reg(context.ret_reg));
+        context.emit(I_CALL, context.symbol("lol_print_yarn"), none(), line);
+        pop_to(after, context);
+        if (temp)
+          free_yarn(after, context);
+      }
+      else
+      {
+        run_hook(expr, context);
+        context.emit(I_PUSH, reg(context.ret_reg));
+        context.emit(I_CALL, context.symbol("lol_print_numbr"), none(), line);
+      }
+      pop_to(depth, context);
+      if (node->nodecount == 1)
+        context.emit(I_CALL, context.symbol("lol_print_newline"));
     }
     catch (HookError e)
     {
@@ -850,18 +2761,20 @@ namespace LOLCode
       if (assign_id == 0)
         throw HookError("Could not find token id for \"assignment\"", rule, line);
       // Build ASTNodes to execute the equivalent statements
-      void *op = node->nodes[0];
-      void *lv = node->nodes[1];
-      void *iv = node->nodes[2];
+      char op = ast_char(node, 0);
+      ASTNode *lv = ast_child(node, 1);
+      ASTNode *iv = ast_child(node, 2);
       ASTNode *as_node = create_ast_node(assign_id, line, 0);
       ASTNode *ex_node = create_ast_node(expr_id, line, 0);
       append_leaf(as_node, lv);
       append_leaf(as_node, ex_node);
-      append_leaf(ex_node, op);
+      append_char(ex_node, op);
       append_leaf(ex_node, lv);
       append_leaf(ex_node, iv);
       // Run it
-      hook_search( "assignment" )(as_node, context);
+      run_hook(as_node, context);
+      free_ast_node(ex_node);
+      free_ast_node(as_node);
     }
     catch (HookError e)
     {
@@ -892,12 +2805,12 @@ namespace LOLCode
     {
       if (node->nodecount == 1)
       { // straight-up array
-        ASTNode *expr = (ASTNode*)node->nodes[0];
-        hook_search( type_names[expr->type] )(expr, context);
+        ASTNode *expr = ast_child(node, 0);
+        run_hook(expr, context);
       }
-      else if (node->nodecount == 0)
-      { // sub-indexed array
-        cout << "1" << std::flush;
+      else
+      { // defaults to 1
+        context.emit(I_MOVL, imm(1), reg(context.ret_reg), line);
       }
     }
     catch (HookError e)
@@ -929,12 +2842,8 @@ namespace LOLCode
     {
       if (node->nodecount == 1)
       { // straight-up array
-        ASTNode *expr = (ASTNode*)node->nodes[0];
-        hook_search( type_names[expr->type] )(expr, context);
-      }
-      else if (node->nodecount == 0)
-      { // sub-indexed array
-        cout << "ITZ IDK" << std::flush;
+        ASTNode *expr = ast_child(node, 0);
+        run_hook(expr, context);
       }
     }
     catch (HookError e)
@@ -945,6 +2854,26 @@ namespace LOLCode
   }
 
 
+  /*!
+   * \brief Mark the start of a statement for the profiler
+   *
+   * Emits a call to lolprof_line (in asmutil) that counts an execution of the
+   * line and charges the cycles since the last mark to the previous line.
+   * All of the registers are saved around the call.
+   *
+   * \param line The line of the input file the statement is on
+   * \param context The compiler context
+   */
+
+  static void profile_line(unsigned line, CompilerContext &context)
+  {
+    context.emit(I_PUSHAL, none(), none(), "profile");
+    context.emit(I_PUSH, imm(line));
+    context.emit(I_CALL, context.symbol("lolprof_line"));
+    context.emit(I_ADDL, imm(4), reg(context.stack_ptr));
+    context.emit(I_POPAL);
+  }
+
   /*!
    * \brief Call blindly all of the nodes linked to this one.
    *
@@ -966,10 +2895,11 @@ namespace LOLCode
     {
       for (unsigned i = 0; i < node->nodecount; ++i)
       {
-        ASTNode *child = (ASTNode*)node->nodes[i];
-        string child_rule = type_names[child->type];
+        ASTNode *child = ast_child(node, i);
         line = child->lineno;
-        hook_search( type_names[child->type] )(child, context);
+        if (context.flags["profile"])
+          profile_line(line, context);
+        run_hook(child, context);
       }
     }
     else
@@ -978,12 +2908,54 @@ namespace LOLCode
     }
   }
 
+  /*!
+   * \param context The compiler context
+   * \param out Where to write the assembly
+   * \return false if the program does not parse
+   * \throw HookError If a statement can't be compiled
+   */
+
+  bool compile_stream(CompilerContext &context, std::ostream &out)
+  {
+    stream_ast_open();
+    ASTNode *stmt = stream_ast_next(); // (HAI has been parsed by now)
+    unsigned line = program_lineno;
+    try
+    {
+      program_start(line, context);
+      while (stmt != NULL)
+      {
+        if (context.flags["profile"])
+          profile_line(stmt->lineno, context);
+        size_t ints = context.int_stack.size(), strs = context.string_stack.size();
+        find_yarns(stmt, context); // (the statements before this one have run by the time it stores one)
+        run_hook(stmt, context);
+        free_ast_tree(stmt);
+        out << context.flush();
+        // Some hooks leave their result on these, and nothing after the statement wants it
+        while (context.int_stack.size() > ints)
+          context.int_stack.pop();
+        while (context.string_stack.size() > strs)
+          context.string_stack.pop();
+        stmt = stream_ast_next();
+      }
+      program_finish(line, context);
+      out << context.flush();
+    }
+    catch (HookError e)
+    {
+      stream_ast_close();
+      e.called_by("program", line);
+      throw e;
+    }
+    return stream_ast_close() == 0;
+  }
+
   /*!
    * \brief Does nothing.
    */
   void noop(ASTNode *node, CompilerContext &context)
   {
-    cout << "  BTW Noop" << endl;
   }
 
   const Hook hooks[] = {
@@ -994,10 +2966,12 @@ namespace LOLCode
     { "condexpr", condexpr },
     { "conditional", conditional },
     { "declaration", assignment },
+    { "exit", exit_program },
     { "expr", expr },
     { "include", noop },
     { "initializer", initializer },
     { "increment_expr", inc_expr },
+    { "input", input },
     { "loop", loop },
     { "loops", fork },
     { "number", constant },
@@ -1006,6 +2980,7 @@ namespace LOLCode
     { "self_assignment", increment },
     { "stmt", fork },
     { "stmts", fork },
+    { "string", yarn },
     { NULL, NULL }
   };
 }
@@ -5,8 +5,11 @@
 #include <vector>
 #include <stack>
 #include <map>
+#include <set>
+#include <ostream>
 
 #include "ast.h"
+#include "insn.hpp"
 
 /*!
  * \brief LOLCode parser/compiler/interpreter data/functions
@@ -21,6 +24,7 @@ namespace LOLCode
   using std::vector;
   using std::stack;
   using std::map;
+  using std::set;
 
   /*!
    * \brief Holds the current execution context of the compiler
@@ -32,25 +36,36 @@ namespace LOLCode
    * compile information, etc.
    */
 
+  /*!
+   * \brief Call counts and time spent in one hook (see CompilerContext::timing)
+   */
+  typedef struct {
+    unsigned long calls; /*!< Number of times the hook was run */
+    double seconds;      /*!< Wall time spent in the hook, including the hooks it ran */
+    double self_seconds; /*!< Wall time spent in the hook itself */
+  } HookStats;
+
   class CompilerContext
   {
     public:
       const static int tab_width = 20;
-      const static string ret_reg;
-      const static string var_reg;
-      const static string cnt_reg;
-      const static string val_reg;
-      const static string dim_reg;
-      const static string ptr_reg;
-      const static string frame_ptr;
-      const static string stack_ptr;
+      const static Reg ret_reg = EAX;
+      const static Reg var_reg = EBX;
+      const static Reg cnt_reg = ECX;
+      const static Reg val_reg = EDX;
+      const static Reg dim_reg = ESI;
+      const static Reg ptr_reg = EDI;
+      const static Reg frame_ptr = EBP;
+      const static Reg stack_ptr = ESP;
 
       unsigned int counter; /*!< This counter remains unique and should only increment */
       string filename; /*!< Set this to the input filename (used in comment generation) */
 
       map<string,bool> flags; /*!< Holds various flags that should persist */
       vector<string> header_pieces; /*!< Holds the source of the output program's header */
-      vector<string> file_pieces; /*!< Holds the source of the output program */
+      vector<Insn> insns; /*!< Holds the code of the output program */
+      vector<string> strings; /*!< Holds the text of the symbols, comments and raw lines in insns */
+      map<string,unsigned> string_ids; /*!< Holds the index of each entry in strings */
       map<string, map<string,int> > offset; /*!< Holds the symbols we're using and their offsets */
       map<string, map<string,string> > variables; /*!< Holds the variables that we're using and their types */
       map<string, map<string,vector<int> > > dimensions; /*!< Holds the sizes of the arrays we're using */
@@ -63,7 +78,22 @@ namespace LOLCode
       stack<string> context_stack; /*!< Stack up strings representing what blocks we're in */
       stack<string> varcontext_stack; /*!< Stack up strings when we change variable exclusive scope */
 
-      map<string,int> mem_stack; /*!< Holds where the current %esp is relative to %ebp (for use in allocating local variables) */
+      int stack_depth; /*!< How many bytes have been pushed onto the stack since main (kept up to date by emit) */
+      map<string,int> mem_stack; /*!< Holds the stack_depth at the start of each block, by context */
+      vector<string> scope_vars; /*!< Holds the variables in the order they were allocated (so blocks can drop theirs) */
+      map<string,unsigned> scope_start; /*!< Holds the size of scope_vars at the start of each block, by context */
+      set<string> indexed; /*!< Holds the variables indexed anywhere in the program (the rest are scalars when the "promote" flag is set) */
+      set<string> yarn_vars; /*!< Holds the variables a YARN can be stored in anywhere (they may hold either a YARN or a NUMBR, see find_yarns) */
+      map<string,int> element_slots; /*!< Holds the stack_depth at which the address of the element being assigned to is kept, by element_key */
+      string pinned; /*!< Holds the variable whose dense block is in ptr_reg and frame_ptr, if any (see loop) */
+
+      bool timing; /*!< Set this to collect hook_stats as the hooks run */
+      map<string,HookStats> hook_stats; /*!< Holds the per-rule statistics when timing */
+      double child_seconds; /*!< Time spent in the hooks run by the current hook (used when timing) */
+      bool flushed; /*!< Set once flush has been called */
+      bool debug; /*!< Set this to emit .loc and CFI directives, for debuggers and profilers (see emit) */
+      bool comments; /*!< Clear this to leave the comments out of the output */
+      int cfa_depth; /*!< The stack_depth the last CFI directive described (when debug is set) */
 
       CompilerContext();
 
@@ -72,7 +102,16 @@ namespace LOLCode
       void output(string piece, string comment = "");
       void output(string piece, unsigned lineno);
       void output_raw(string piece);
+      void emit(Opcode op, Operand a = none(), Operand b = none(), unsigned lineno = 0);
+      void emit(Opcode op, Operand a, Operand b, const string &comment);
+      unsigned intern(const string &text);
+      Operand symbol(const string &name);
+      Operand address(const string &name);
       string build_file(); 
+      string flush();
+
+    private:
+      void render_insns(string &output);
   };
 
   /*! \brief The Abstract Syntax Tree (A.S.T) Node */
@@ -124,10 +163,20 @@ namespace LOLCode
   HookFunc hook_search(string id);
 
   /*!
-   * \brief Convert anything to anything
+   * \brief Search for and run the hook for a node
+   */
+  void run_hook(ASTNode *node, CompilerContext &context);
+
+  /*!
+   * \brief Compile a program one top-level statement at a time, as it is parsed
+   *
+   * Each statement is compiled, written out and freed before the next one is
+   * parsed, so only the largest statement (a whole loop, say) is ever held.
+   * The program is never seen whole, so its variables are never promoted to
+   * scalars (see program), and each statement is looked over for the
+   * variables a YARN can reach just before it is compiled.
    */
-  template <typename IN, typename OUT>
-  OUT convert(IN i);
+  bool compile_stream(CompilerContext &context, std::ostream &out);
 }
 
 #endif
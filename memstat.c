@@ -0,0 +1,50 @@
+/*! \file Counting wrappers around the C library's allocator (see memstat.h) */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstat.h"
+
+/* glibc's own entry points, which the wrappers below forward to */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static memstat_t counters;
+
+void *malloc(size_t size)
+{
+  ++counters.allocs;
+  counters.bytes += size;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+  ++counters.allocs;
+  counters.bytes += nmemb * size;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  ++counters.allocs;
+  counters.bytes += size;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+  if (ptr != NULL)
+    ++counters.frees;
+  __libc_free(ptr);
+}
+
+/*!
+ * \brief Copy out the current counters
+ */
+void memstat_get(memstat_t *stat)
+{
+  memcpy(stat, &counters, sizeof(counters));
+}
@@ -0,0 +1,29 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+#include <stddef.h>
+
+/*!
+ * \brief Heap allocation counters
+ *
+ * Linking memstat.o into a program replaces malloc() and friends with thin
+ * wrappers that count every call before handing it to the C library.  Take a
+ * snapshot before and after a piece of work and subtract.
+ */
+typedef struct {
+  unsigned long allocs;     /*!< Calls to malloc, calloc and realloc */
+  unsigned long frees;      /*!< Calls to free with a non-NULL pointer */
+  unsigned long long bytes; /*!< Bytes requested by those allocations */
+} memstat_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void memstat_get(memstat_t *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,331 @@
+#include <string>
+#include <ostream>
+using std::endl;
+
+#include <cstring>
+
+#include "printer.hpp"
+#include "ast.h"
+
+namespace LOLCode
+{
+  using std::string;
+
+  /*!
+   * \param o The stream to write the program to
+   */
+  Printer::Printer(std::ostream &o)
+    : out(o), depth(0)
+  {
+  }
+
+  /*!
+   * \brief Indent the start of a statement
+   */
+  void Printer::indent()
+  {
+    out << string(depth*2, ' ');
+  }
+
+  /*!
+   * Search through the print hooks and run the one for the rule that
+   * generated the node
+   * \param node The node to print
+   * \param printer The printer state
+   * \throw HookError If the print hook is not found
+   */
+  void print_node(ASTNode *node, Printer &printer)
+  {
+    unsigned i;
+    for (i = 0; print_hooks[i].id != NULL; ++i)
+    {
+      if (strcmp(type_names[node->type], print_hooks[i].id) == 0)
+        break;
+    }
+    if (print_hooks[i].id == NULL)
+      throw HookError("Unable to locate print hook for: " + string(type_names[node->type]));
+    print_hooks[i].func(node, printer);
+  }
+
+  /*!
+   * \param root The root of the A.S.T. (the program node)
+   * \param out The stream to write the program to
+   */
+  void pretty_print(ASTNode *root, std::ostream &out)
+  {
+    Printer printer(out);
+    print_node(root, printer);
+    out << std::flush;
+  }
+
+  /*!
+   * \brief Print a statement list, one statement per line
+   */
+  static void print_stmts(ASTNode *node, Printer &printer)
+  {
+    if (node->terminal)
+      return;
+    for (unsigned i = 0; i < node->nodecount; ++i)
+    {
+      ASTNode *child = ast_child(node, i);
+      printer.indent();
+      print_node(child, printer);
+      printer.out << "\n";
+    }
+  }
+
+  /*!
+   * \brief Print a block of statements one level deeper
+   */
+  static void print_block(ASTNode *node, Printer &printer)
+  {
+    printer.depth += 1;
+    print_node(node, printer);
+    printer.depth -= 1;
+  }
+
+  static void print_program(ASTNode *node, Printer &printer)
+  {
+    printer.out << "HAI\n";
+    print_block(ast_child(node, 0), printer);
+    printer.out << "KTHXBYE" << endl;
+  }
+
+  static void print_word(ASTNode *node, Printer &printer)
+  {
+    printer.out << ast_text(node, 0);
+  }
+
+  static void print_number(ASTNode *node, Printer &printer)
+  {
+    printer.out << ast_int(node, 0);
+  }
+
+  static void print_string(ASTNode *node, Printer &printer)
+  {
+    printer.out << "\"";
+    for (const char *c = ast_text(node, 0); *c; ++c)
+    {
+      switch (*c)
+      {
+        case '\n': printer.out << "\\n"; break;
+        case '\t': printer.out << "\\t"; break;
+        case '\r': printer.out << "\\r"; break;
+        case '\b': printer.out << "\\b"; break;
+        case '\f': printer.out << "\\f"; break;
+        case '"':  printer.out << "\\\""; break;
+        case '\\': printer.out << "\\\\"; break;
+        default:   printer.out << *c; break;
+      }
+    }
+    printer.out << "\"";
+  }
+
+  static void print_array(ASTNode *node, Printer &printer)
+  {
+    if (node->nodecount == 1)
+    {
+      print_node(ast_child(node, 0), printer);
+      return;
+    }
+    printer.out << "MAH ";
+    print_node(ast_child(node, 0), printer);
+    printer.out << "!!";
+    print_node(ast_child(node, 1), printer);
+  }
+
+  static void print_assignment(ASTNode *node, Printer &printer)
+  {
+    printer.out << "LOL ";
+    print_node(ast_child(node, 0), printer);
+    printer.out << " R ";
+    print_node(ast_child(node, 1), printer);
+  }
+
+  static void print_declaration(ASTNode *node, Printer &printer)
+  {
+    printer.out << "I HAS A ";
+    print_node(ast_child(node, 0), printer);
+    print_node(ast_child(node, 1), printer);
+  }
+
+  static void print_initializer(ASTNode *node, Printer &printer)
+  {
+    if (node->nodecount == 0)
+      return;
+    printer.out << " ITZ ";
+    print_node(ast_child(node, 0), printer);
+  }
+
+  static void print_brk(ASTNode *node, Printer &printer)
+  {
+    printer.out << "GTFO";
+  }
+
+  static void print_comment(ASTNode *node, Printer &printer)
+  {
+    printer.out << "BTW";
+  }
+
+  static void print_include(ASTNode *node, Printer &printer)
+  {
+    printer.out << "CAN HAS ";
+    print_node(ast_child(node, 0), printer);
+    printer.out << "?";
+  }
+
+  static void print_condexpr(ASTNode *node, Printer &printer)
+  {
+    if (node->nodecount == 1) // strict boolean literal
+    {
+      printer.out << ((ast_int(node, 0) == 1) ? "WIN" : "FAIL");
+      return;
+    }
+    switch (ast_char(node, 0))
+    {
+      case '!': printer.out << "NOT "; break;
+      case '>': printer.out << "BIGR "; break;
+      case '<': printer.out << "SMALR "; break;
+      case '=': printer.out << "LIEK "; break;
+      case '|': printer.out << "OR "; break;
+      case '&': printer.out << "AND "; break;
+      case '^': printer.out << "XOR "; break;
+    }
+    print_node(ast_child(node, 1), printer);
+    if (node->nodecount == 3)
+    {
+      printer.out << " AN ";
+      print_node(ast_child(node, 2), printer);
+    }
+  }
+
+  static void print_conditional(ASTNode *node, Printer &printer)
+  {
+    printer.out << "IZ ";
+    print_node(ast_child(node, 0), printer);
+    printer.out << "\n";
+    print_block(ast_child(node, 1), printer);
+    if (node->nodecount == 3)
+    {
+      printer.indent();
+      printer.out << "NOWAI\n";
+      print_block(ast_child(node, 2), printer);
+    }
+    printer.indent();
+    printer.out << "KTHX";
+  }
+
+  static void print_expr(ASTNode *node, Printer &printer)
+  {
+    switch (ast_char(node, 0))
+    {
+      case '+': printer.out << "UP "; break;
+      case '-': printer.out << "NERF "; break;
+      case '*': printer.out << "TIEMZ "; break;
+      case '/': printer.out << "OVAR "; break;
+    }
+    print_node(ast_child(node, 1), printer);
+    printer.out << " AN ";
+    print_node(ast_child(node, 2), printer);
+  }
+
+  static void print_exit(ASTNode *node, Printer &printer)
+  {
+    printer.out << ((ast_char(node, 0) == 'D') ? "DIAF" : "BYES");
+    print_node(ast_child(node, 1), printer);
+    print_node(ast_child(node, 2), printer);
+  }
+
+  /*!
+   * \brief Print an optional argument (exit_status, exit_message, ...)
+   */
+  static void print_optional(ASTNode *node, Printer &printer)
+  {
+    if (node->nodecount == 0)
+      return;
+    printer.out << " ";
+    print_node(ast_child(node, 0), printer);
+  }
+
+  static void print_input(ASTNode *node, Printer &printer)
+  {
+    ASTNode *type = ast_child(node, 0);
+    ASTNode *from = ast_child(node, 2);
+    printer.out << "GIMMEH ";
+    if (type->nodecount == 1)
+    {
+      switch (ast_char(type, 0))
+      {
+        case 'W': printer.out << "WORD "; break;
+        case 'L': printer.out << "LINE "; break;
+        case 'C': printer.out << "LETTAR "; break;
+      }
+    }
+    print_node(ast_child(node, 1), printer);
+    if (strcmp(type_names[from->type], "word") == 0)
+    {
+      printer.out << " OUTTA ";
+      print_node(from, printer);
+    }
+  }
+
+  static void print_loop(ASTNode *node, Printer &printer)
+  {
+    printer.out << "IM IN YR ";
+    print_node(ast_child(node, 0), printer);
+    printer.out << "\n";
+    print_block(ast_child(node, 1), printer);
+    printer.indent();
+    printer.out << "LOL";
+  }
+
+  static void print_output(ASTNode *node, Printer &printer)
+  {
+    printer.out << "VISIBLE ";
+    print_node(ast_child(node, 0), printer);
+    if (node->nodecount == 2)
+      printer.out << "!";
+  }
+
+  static void print_self_assignment(ASTNode *node, Printer &printer)
+  {
+    switch (ast_char(node, 0))
+    {
+      case '+': printer.out << "UPZ "; break;
+      case '-': printer.out << "NERFZ "; break;
+      case '*': printer.out << "TIEMZD "; break;
+      case '/': printer.out << "OVARZ "; break;
+    }
+    print_node(ast_child(node, 1), printer);
+    printer.out << "!!";
+    ASTNode *amount = ast_child(node, 2);
+    if (amount->nodecount == 1)
+      print_node(ast_child(amount, 0), printer);
+  }
+
+  const PrintHook print_hooks[] = {
+    { "array", print_array },
+    { "assignment", print_assignment },
+    { "brk", print_brk },
+    { "comment", print_comment },
+    { "condexpr", print_condexpr },
+    { "conditional", print_conditional },
+    { "declaration", print_declaration },
+    { "exit", print_exit },
+    { "exit_message", print_optional },
+    { "exit_status", print_optional },
+    { "expr", print_expr },
+    { "include", print_include },
+    { "initializer", print_initializer },
+    { "input", print_input },
+    { "loop", print_loop },
+    { "number", print_number },
+    { "output", print_output },
+    { "program", print_program },
+    { "self_assignment", print_self_assignment },
+    { "stmts", print_stmts },
+    { "string", print_string },
+    { "word", print_word },
+    { NULL, NULL }
+  };
+}
@@ -0,0 +1,49 @@
+#ifndef PRINTER_H
+#define PRINTER_H
+
+#include <ostream>
+
+#include "lolcode.hpp"
+
+namespace LOLCode
+{
+  /*!
+   * \brief Holds the state of the pretty-printer as it walks the A.S.T.
+   */
+  class Printer
+  {
+    public:
+      std::ostream &out; /*!< Where the program is written */
+      unsigned depth;    /*!< How many blocks deep the current statement is */
+
+      Printer(std::ostream &o);
+
+      void indent();
+  };
+
+  /*! \brief The types of functions stored in print_hooks */
+  typedef void (*PrintFunc)(ASTNode *node, Printer &printer);
+
+  /*!
+   * \brief A function used to print an A.S.T. node
+   */
+  typedef struct {
+    const char *id;               /*!< The name of the rule that made the node to print */
+    PrintFunc func;               /*!< the address of the function to call */
+  } PrintHook;
+
+  /*! A list of print hooks for the A.S.T. nodes */
+  extern const PrintHook print_hooks[];
+
+  /*!
+   * \brief Search for and run the print hook for a node
+   */
+  void print_node(ASTNode *node, Printer &printer);
+
+  /*!
+   * \brief Write a program back out as (normalized) LOLCODE
+   */
+  void pretty_print(ASTNode *root, std::ostream &out);
+}
+
+#endif